@@ -0,0 +1,31 @@
+/* block_pool.c
+   The 4KB image block pool, see block_pool.h.
+*/
+
+#include <stddef.h>
+#include "block_pool.h"
+
+static uint8_t blocks[BLOCK_POOL_COUNT][BLOCK_POOL_BLOCK_SIZE] __attribute__((aligned(4)));
+static uint32_t freeBlocks = (1u << BLOCK_POOL_COUNT) - 1; // One bit per block
+
+uint8_t* blockPoolAcquire(void) {
+  for (uint32_t i = 0; i < BLOCK_POOL_COUNT; i++) {
+    if (freeBlocks & (1u << i)) {
+      freeBlocks &= ~(1u << i);
+      return blocks[i];
+    }
+  }
+  return NULL;
+}
+
+void blockPoolRelease(const uint8_t* block) {
+  if (block == NULL) {
+    return;
+  }
+  uint32_t i = (uint32_t)((block - &blocks[0][0]) / BLOCK_POOL_BLOCK_SIZE);
+  freeBlocks |= 1u << i;
+}
+
+uint32_t blockPoolAvailable(void) {
+  return (uint32_t)__builtin_popcount(freeBlocks);
+}
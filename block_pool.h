@@ -0,0 +1,29 @@
+/* block_pool.h
+   A pool of 4KB blocks for image data on its way from the SD card to the data pins.
+
+   FatFs reads straight into a pool block, the block goes to the bus engine in a BusCommand and
+   comes back with its result, so the image is never copied in between. The blocks are 4 byte
+   aligned for the 32 bit DMA transfers. Whoever acquired a block owns it until they release it,
+   lending it to core1 while a command using it is in flight. Acquire and release from core0 only.
+   Plain C, no Pico SDK: tests/test_sd_stream.c takes the stream's blocks from it on the host.
+*/
+
+#ifndef _inc_block_pool
+#define _inc_block_pool
+
+#include <stdint.h>
+
+#define BLOCK_POOL_BLOCK_SIZE 4096
+#define BLOCK_POOL_COUNT 8 // The SD stream's blocks, or both halves of a 4 socket interleaved job
+
+/// @brief blockPoolAcquire() takes a free block out of the pool.
+/// @return The block, or NULL if every block is in use
+uint8_t* blockPoolAcquire(void);
+
+/// @brief blockPoolRelease() gives a block back to the pool. NULL is ignored.
+void blockPoolRelease(const uint8_t* block);
+
+/// @brief blockPoolAvailable() is the number of free blocks.
+uint32_t blockPoolAvailable(void);
+
+#endif
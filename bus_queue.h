@@ -0,0 +1,86 @@
+/* bus_queue.h
+   Lock-free single-producer / single-consumer queue used to hand bus commands
+   from core0 (SD card, UI) to core1 (the EEPROM bus engine), and results back.
+
+   Exactly one core may push to a given queue and exactly one core may pop from it.
+   head is only written by the producer and tail only by the consumer, so no locks
+   or read-modify-write atomics are needed (the Cortex-M0+ doesn't have them anyway).
+   Nothing here needs the Pico SDK: tests/test_bus_queue.c runs the queue between two host threads.
+*/
+
+#ifndef _inc_bus_queue
+#define _inc_bus_queue
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BUS_QUEUE_LENGTH 8 // Must be a power of two
+#define BUS_MAX_SOCKETS 4  // Sockets a BUS_CMD_INTERLEAVED_PROGRAM carries data for
+
+/// @brief The operations the bus engine knows how to run.
+typedef enum {
+  BUS_CMD_PROGRAM,        // Program length bytes from data starting at address
+  BUS_CMD_VERIFY,         // Compare length bytes from data against the EEPROM starting at address
+  BUS_CMD_ERASE_SECTOR,   // Erase the chip's erase sector containing address, no data
+  BUS_CMD_PROGRAM_ERASED, // Program length bytes from data into freshly erased space at address
+  BUS_CMD_GANG_PROGRAM,   // BUS_CMD_PROGRAM_ERASED into every socket in the gang at once
+  BUS_CMD_INTERLEAVED_PROGRAM // Each socket in the gang gets its own block, from socketData
+} BusCommandType;
+
+/// @brief A bus command going to core1, which comes back as the result once it has run.
+typedef struct {
+  BusCommandType type;
+  uint32_t address;       // First EEPROM address
+  const uint8_t* data;    // Data buffer, owned by the bus engine until the result comes back
+  const uint8_t* socketData[BUS_MAX_SOCKETS]; // BUS_CMD_INTERLEAVED_PROGRAM's per-socket buffers, likewise
+  uint32_t length;        // Number of bytes in data
+  uint32_t sockets;       // BUS_CMD_INTERLEAVED_PROGRAM: the sockets to program, a bit each
+  uint32_t tag;           // Free for the producer to use, e.g. which buffer this is
+  bool ok;                // Result: true if the command succeeded
+  uint32_t failedAddress; // Result: where it failed if it did not
+  uint32_t failedSockets; // Result: the sockets a BUS_CMD_INTERLEAVED_PROGRAM dropped, for core0 to take out
+} BusCommand;
+
+/// @brief The queue itself. head and tail are free running counters.
+typedef struct {
+  atomic_uint head; // Next slot to write, only written by the producer
+  atomic_uint tail; // Next slot to read, only written by the consumer
+  BusCommand items[BUS_QUEUE_LENGTH];
+} BusQueue;
+
+/// @brief busQueueInit() empties the queue. Only call it while neither side is using it.
+static inline void busQueueInit(BusQueue* queue) {
+  atomic_store_explicit(&queue->head, 0, memory_order_relaxed);
+  atomic_store_explicit(&queue->tail, 0, memory_order_relaxed);
+}
+
+/// @brief busQueuePush() adds a command to the queue (producer side only).
+/// @return false if the queue is full
+static inline bool busQueuePush(BusQueue* queue, const BusCommand* command) {
+  unsigned head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+  if (head - tail == BUS_QUEUE_LENGTH) {
+    return false;
+  }
+
+  queue->items[head & (BUS_QUEUE_LENGTH - 1)] = *command;
+  atomic_store_explicit(&queue->head, head + 1, memory_order_release); // Publish the item
+  return true;
+}
+
+/// @brief busQueuePop() takes the oldest command off the queue (consumer side only).
+/// @return false if the queue is empty
+static inline bool busQueuePop(BusQueue* queue, BusCommand* command) {
+  unsigned tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  unsigned head = atomic_load_explicit(&queue->head, memory_order_acquire);
+  if (head == tail) {
+    return false;
+  }
+
+  *command = queue->items[tail & (BUS_QUEUE_LENGTH - 1)];
+  atomic_store_explicit(&queue->tail, tail + 1, memory_order_release); // Hand the slot back
+  return true;
+}
+
+#endif
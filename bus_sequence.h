@@ -0,0 +1,71 @@
+/* bus_sequence.h
+   The fixed command sequences (unlock, erase, Software ID, unlock bypass and the AT28C software
+   data protection) as tables built at compile time, for writeSequence() to put on the bus.
+
+   Every cycle carries its shift_register PIO word already worked out, so writeSequence() can
+   hand the next cycle's address to the PIO while the current one still has /WE low, without
+   working anything out. The bulk program engine gets its whole-cycle words the same way.
+   Only the target address and data of a byte program or a sector erase are put together at
+   run time. All of these are plain /WE controlled write cycles.
+   Include this after shift_register.pio.h and bulk_program.pio.h, which define SHIFT_WORD() and
+   BULK_PROGRAM_WORD().
+*/
+
+#ifndef _inc_bus_sequence
+#define _inc_bus_sequence
+
+#include <stdint.h>
+
+/// @brief One write cycle of a command sequence.
+typedef struct {
+  uint32_t address;
+  uint8_t data;
+  uint32_t preloadWord; // SHIFT_WORD(address, SHIFT_FLAG_SHIFT): shift it in without latching
+  uint32_t bulkWord;    // BULK_PROGRAM_WORD(address, data, 0): the whole cycle, for the bulk program engine
+} BusCycle;
+
+#define BUS_CYCLE(address, data) \
+  { (address), (data), SHIFT_WORD((address), SHIFT_FLAG_SHIFT), BULK_PROGRAM_WORD((address), (data), 0) }
+#define BUS_SEQUENCE_LENGTH(sequence) (sizeof(sequence) / sizeof((sequence)[0]))
+
+// Byte program, then the target address and data. Also the AT28C software data protection
+// enable, in front of a page load. The AMD parts only decode A0 - A10 (0x555 / 0x2AA) here.
+static const BusCycle SEQUENCE_PROGRAM[] = {
+  BUS_CYCLE(0x5555, 0xAA), BUS_CYCLE(0x2AAA, 0x55), BUS_CYCLE(0x5555, 0xA0)
+};
+
+// Chip erase:
+static const BusCycle SEQUENCE_CHIP_ERASE[] = {
+  BUS_CYCLE(0x5555, 0xAA), BUS_CYCLE(0x2AAA, 0x55), BUS_CYCLE(0x5555, 0x80),
+  BUS_CYCLE(0x5555, 0xAA), BUS_CYCLE(0x2AAA, 0x55), BUS_CYCLE(0x5555, 0x10)
+};
+
+// Sector erase, then the sector address and 0x30:
+static const BusCycle SEQUENCE_SECTOR_ERASE[] = {
+  BUS_CYCLE(0x5555, 0xAA), BUS_CYCLE(0x2AAA, 0x55), BUS_CYCLE(0x5555, 0x80),
+  BUS_CYCLE(0x5555, 0xAA), BUS_CYCLE(0x2AAA, 0x55)
+};
+
+// Software ID entry, and the single cycle exit that works from any address:
+static const BusCycle SEQUENCE_SOFTWARE_ID_ENTRY[] = {
+  BUS_CYCLE(0x5555, 0xAA), BUS_CYCLE(0x2AAA, 0x55), BUS_CYCLE(0x5555, 0x90)
+};
+static const BusCycle SEQUENCE_SOFTWARE_ID_EXIT[] = {
+  BUS_CYCLE(0x5555, 0xF0)
+};
+
+// AMD unlock bypass entry, and the unlock bypass reset that leaves it:
+static const BusCycle SEQUENCE_UNLOCK_BYPASS_ENTRY[] = {
+  BUS_CYCLE(0x5555, 0xAA), BUS_CYCLE(0x2AAA, 0x55), BUS_CYCLE(0x5555, 0x20)
+};
+static const BusCycle SEQUENCE_UNLOCK_BYPASS_RESET[] = {
+  BUS_CYCLE(0x0000, 0x90), BUS_CYCLE(0x0000, 0x00)
+};
+
+// AT28C software data protection disable:
+static const BusCycle SEQUENCE_SDP_DISABLE[] = {
+  BUS_CYCLE(0x5555, 0xAA), BUS_CYCLE(0x2AAA, 0x55), BUS_CYCLE(0x5555, 0x80),
+  BUS_CYCLE(0x5555, 0xAA), BUS_CYCLE(0x2AAA, 0x55), BUS_CYCLE(0x5555, 0x20)
+};
+
+#endif
@@ -0,0 +1,83 @@
+/* bus_timing.h
+   Datasheet bus timing, in nanoseconds, and its conversion to CPU cycles.
+
+   Every wait between two bus edges comes from one of the parameters below instead of a
+   delay found by trial and error. busTimingInit() converts them to cycle counts for the
+   current system clock, for the part in the socket (NS_TO_CYCLES() also works at compile
+   time), and the bus code waits on those with busy_wait_at_least_cycles().
+   It doesn't need the Pico SDK; tests/test_bus_timing.c checks the conversion on the host.
+*/
+
+#ifndef _inc_bus_timing
+#define _inc_bus_timing
+
+#include <stdint.h>
+
+/// @brief The EEPROM side, in ns. Each part has its own, see chip_table.h.
+typedef struct {
+  uint32_t accessNs;         // tACC: address to data valid
+  uint32_t outputEnableNs;   // tOE: /OE low to data valid
+  uint32_t outputDisableNs;  // tDF: /OE high to the data bus released (tOHZ)
+  uint32_t addressSetupNs;   // tAS: address setup to /WE (or /CE) falling
+  uint32_t addressHoldNs;    // tAH: address hold from /WE (or /CE) falling
+  uint32_t writePulseNs;     // tWP: /WE pulse width
+  uint32_t writePulseHighNs; // tWPH: /WE high between pulses
+  uint32_t dataSetupNs;      // tDS: data setup to /WE (or /CE) rising
+  uint32_t dataHoldNs;       // tDH: data hold from /WE (or /CE) rising
+  uint32_t idAccessNs;       // tIDA: Software ID entry / exit to the next access
+} EepromTiming;
+
+#define EEPROM_T_BLC_NS 150000 // AT28C page load: the most allowed between two byte loads
+
+// 74HC595 at 4.5V, worst case up to 85C, in ns. We drive it at 3.3V (see SHIFT_REGISTER_CLOCK_HZ)
+// but the widths are a few times larger than the CPU can toggle a pin anyway.
+#define SHIFT_T_SU_NS 20     // DS setup to SHCP rising
+#define SHIFT_T_H_NS 3       // DS hold from SHCP rising
+#define SHIFT_T_W_NS 20      // SHCP / STCP pulse width
+#define SHIFT_T_REM_NS 20    // SHCP rising to STCP rising
+#define SHIFT_T_PD_NS 30     // STCP rising to the outputs settled
+
+// TXB0108 level shifter between the Pico and the EEPROM data bus, each way:
+#define LEVEL_SHIFT_T_PD_NS 10
+
+/// @brief NS_TO_CYCLES() rounds ns up to whole cycles at hz.
+#define NS_TO_CYCLES(ns, hz) ((uint32_t)(((uint64_t)(ns) * (hz) + 999999999u) / 1000000000u))
+
+#define BUS_TIMING_MAX(a, b) ((a) > (b) ? (a) : (b))
+
+/// @brief The waits the bus code uses, in CPU cycles.
+typedef struct {
+  uint32_t sysHz;            // The clock these were worked out for
+  uint32_t shiftDataSetup;   // Bit-banged DS to SHCP rising, covers tH as well
+  uint32_t shiftClockWidth;  // Bit-banged SHCP / STCP high and low times, and SHCP to STCP
+  uint32_t addressSetup;     // Latch to /WE falling: outputs settled, plus tAS
+  uint32_t writePulse;       // /WE low time: tWP, tDS for data set just before, tAH
+  uint32_t writePulseHigh;   // /WE high before the next cycle can start
+  uint32_t readAccess;       // Latch to sampling the data bus with /OE already low
+  uint32_t outputEnable;     // /OE falling to sampling the data bus
+  uint32_t outputDisable;    // /OE rising to driving the data bus
+  uint32_t idAccess;         // Software ID entry / exit command to the next access
+} BusTiming;
+
+/// @brief busReadAccessNs() is the time from the latch edge to valid data on the Pico's pins: the
+///        74HC595 outputs settling, tACC, and the TXB0108 on the way back.
+static inline uint32_t busReadAccessNs(const EepromTiming* eeprom) {
+  return SHIFT_T_PD_NS + eeprom->accessNs + LEVEL_SHIFT_T_PD_NS;
+}
+
+/// @brief busTimingInit() converts the datasheet parameters of one part to cycles at sysHz.
+static inline void busTimingInit(BusTiming* timing, uint32_t sysHz, const EepromTiming* eeprom) {
+  timing->sysHz = sysHz;
+  timing->shiftDataSetup = NS_TO_CYCLES(SHIFT_T_SU_NS, sysHz);
+  timing->shiftClockWidth = NS_TO_CYCLES(BUS_TIMING_MAX(SHIFT_T_W_NS, SHIFT_T_REM_NS), sysHz);
+  timing->addressSetup = NS_TO_CYCLES(SHIFT_T_PD_NS + eeprom->addressSetupNs, sysHz);
+  timing->writePulse = NS_TO_CYCLES(BUS_TIMING_MAX(BUS_TIMING_MAX(eeprom->writePulseNs, eeprom->addressHoldNs),
+                                                   eeprom->dataSetupNs + LEVEL_SHIFT_T_PD_NS), sysHz);
+  timing->writePulseHigh = NS_TO_CYCLES(BUS_TIMING_MAX(eeprom->writePulseHighNs, eeprom->dataHoldNs), sysHz);
+  timing->readAccess = NS_TO_CYCLES(busReadAccessNs(eeprom), sysHz);
+  timing->outputEnable = NS_TO_CYCLES(eeprom->outputEnableNs + LEVEL_SHIFT_T_PD_NS, sysHz);
+  timing->outputDisable = NS_TO_CYCLES(eeprom->outputDisableNs, sysHz);
+  timing->idAccess = NS_TO_CYCLES(eeprom->idAccessNs, sysHz);
+}
+
+#endif
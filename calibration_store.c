@@ -0,0 +1,57 @@
+/* calibration_store.c
+   Bus timing calibration kept in the last sector of the RP2040's flash, see calibration_store.h.
+*/
+
+#include <stddef.h>
+#include <string.h>
+#include "hardware/flash.h"
+#include "pico/flash.h"
+#include "calibration_store.h"
+
+#define CALIBRATION_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+#define CALIBRATION_FLASH_TIMEOUT_MS 100
+
+/// @brief calibrationChecksum() is a rotate-and-xor over every field before the checksum.
+static uint32_t calibrationChecksum(const BusCalibration* calibration) {
+  const uint32_t* words = (const uint32_t*)calibration;
+  uint32_t sum = 0;
+  for (size_t i = 0; i < offsetof(BusCalibration, checksum) / sizeof(uint32_t); i++) {
+    sum = ((sum << 5) | (sum >> 27)) ^ words[i];
+  }
+  return sum;
+}
+
+bool calibrationLoad(BusCalibration* calibration) {
+  const BusCalibration* stored = (const BusCalibration*)(XIP_BASE + CALIBRATION_FLASH_OFFSET);
+  if (stored->magic != CALIBRATION_MAGIC || stored->version != CALIBRATION_VERSION ||
+      stored->checksum != calibrationChecksum(stored)) {
+    return false;
+  }
+
+  *calibration = *stored;
+  return true;
+}
+
+/// @brief The flash can't be read while it is being written, so these run with the other core
+///        locked out and interrupts off, from RAM.
+static void __not_in_flash_func(calibrationFlashWrite)(void* param) {
+  flash_range_erase(CALIBRATION_FLASH_OFFSET, FLASH_SECTOR_SIZE);
+  if (param != NULL) {
+    flash_range_program(CALIBRATION_FLASH_OFFSET, (const uint8_t*)param, FLASH_PAGE_SIZE);
+  }
+}
+
+bool calibrationSave(const BusCalibration* calibration) {
+  static uint8_t page[FLASH_PAGE_SIZE] __attribute__((aligned(4))); // Programmed a page at a time
+  memset(page, 0xFF, sizeof(page));
+  BusCalibration* record = (BusCalibration*)page;
+  *record = *calibration;
+  record->magic = CALIBRATION_MAGIC;
+  record->version = CALIBRATION_VERSION;
+  record->checksum = calibrationChecksum(record);
+  return flash_safe_execute(calibrationFlashWrite, page, CALIBRATION_FLASH_TIMEOUT_MS) == PICO_OK;
+}
+
+bool calibrationErase() {
+  return flash_safe_execute(calibrationFlashWrite, NULL, CALIBRATION_FLASH_TIMEOUT_MS) == PICO_OK;
+}
@@ -0,0 +1,45 @@
+/* calibration_store.h
+   Keeps the bus timing found by the calibration command in the last sector of the RP2040's
+   own flash, so it survives a reboot and setup() can load it again.
+
+   The values are stored in ns / Hz rather than cycles, so they still apply if clk_sys changes.
+   The sector is reserved: nothing else may live in the last FLASH_SECTOR_SIZE bytes of flash.
+*/
+
+#ifndef _inc_calibration_store
+#define _inc_calibration_store
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CALIBRATION_MAGIC 0x43414C42u // "CALB"
+#define CALIBRATION_VERSION 3 // 1 didn't record the shift backend, 2 the part, both are ignored
+#define CALIBRATION_ANY_BACKEND 0xFFFFFFFFu // shiftBackend of the datasheet timing, good for either
+
+/// @brief The calibrated bus timing, margin already applied.
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t shiftClockHz;  // PIO shift register clock
+  uint32_t writePulseNs;  // /WE low time
+  uint32_t readAccessNs;  // Latch to sampling the data bus
+  uint32_t shiftBackend;  // The ShiftBackend it was measured on, it only applies to that one
+  uint32_t chipId;        // chipCalibrationId() of the part it was measured on, likewise
+  uint32_t marginPercent; // The safety margin that was applied
+  uint32_t checksum;      // Over everything above
+} BusCalibration;
+
+/// @brief calibrationLoad() reads the stored calibration.
+/// @return false if nothing valid has been stored
+bool calibrationLoad(BusCalibration* calibration);
+
+/// @brief calibrationSave() erases the reserved flash sector and writes calibration to it.
+///        Uses flash_safe_execute(), so core1 must have called multicore_lockout_victim_init().
+/// @return false if the flash could not be written
+bool calibrationSave(const BusCalibration* calibration);
+
+/// @brief calibrationErase() erases the reserved flash sector, back to the datasheet timing.
+/// @return false if the flash could not be erased
+bool calibrationErase();
+
+#endif
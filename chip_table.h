@@ -0,0 +1,87 @@
+/* chip_table.h
+   The parts this programmer knows, by their JEDEC Software Product ID.
+
+   EEPROM_detectChip() reads the manufacturer and device ID and looks them up here. Every loop
+   over the chip is then sized from the entry, and anything not in the table is rejected before
+   it gets erased or programmed.
+   Each entry carries its own bus timing, so only the slow parts pay for it.
+   tests/test_bus_timing.c includes this header on the host and checks every entry's timing.
+*/
+
+#ifndef _inc_chip_table
+#define _inc_chip_table
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bus_timing.h"
+
+/// @brief Which command set a part speaks. The flash parts use the same JEDEC unlock, ID, erase and
+///        Data# / toggle bit sequences, but only the AMD parts have unlock bypass (two cycle byte
+///        program) and the DQ5 exceeded-timing-limits flag. The Atmel parts are byte alterable
+///        EEPROMs: no erase, a whole page is loaded and then written in one go, optionally behind
+///        the software data protection sequence. They have no Software ID either.
+typedef enum {
+  CHIP_FAMILY_SST,  // SST / Microchip 39SF0X0
+  CHIP_FAMILY_AMD,  // AMD / Fujitsu 29F0X0
+  CHIP_FAMILY_ATMEL // Atmel / Microchip AT28C
+} ChipFamily;
+
+/// @brief One supported part. Times are the datasheet typical and maximum values. For page write
+///        parts the "byte program" time is the page write cycle (tWC), and the erase times are for
+///        writing 0xFF over a sector / the chip a page at a time.
+typedef struct {
+  const char* name;
+  ChipFamily family;
+  uint8_t manufacturerId;       // Read from address 0x0000 in Software ID mode
+  uint8_t deviceId;             // Read from address 0x0001 in Software ID mode
+  uint32_t size;                // Bytes
+  uint32_t sectorSize;          // Bytes erased by a sector erase
+  uint32_t pageSize;            // Bytes per page write, 0 for parts that program a byte at a time
+  uint32_t byteProgramTypicalUs;
+  uint32_t byteProgramMaxUs;    // tBP
+  uint32_t sectorEraseTypicalUs;
+  uint32_t sectorEraseMaxUs;    // tSE
+  uint32_t chipEraseTypicalUs;
+  uint32_t chipEraseMaxUs;      // tSCE
+  EepromTiming timing;          // Bus timing, in ns
+} ChipInfo;
+
+// Bus timing of each family, in ns, in EepromTiming order: tACC, tOE, tDF, tAS, tAH, tWP, tWPH,
+// tDS, tDH, tIDA. Each is the slowest speed grade we expect to see in a socket.
+#define EEPROM_TIMING_SST39SF  { 70, 35, 25, 0, 30, 40, 30, 30, 0, 150 }   // 39SF0X0-70
+#define EEPROM_TIMING_AM29F    { 120, 50, 30, 0, 50, 50, 20, 50, 0, 150 }  // 29F0X0-120
+#define EEPROM_TIMING_AT28C    { 150, 70, 50, 0, 50, 100, 50, 50, 0, 150 } // AT28C-15, tIDA unused
+
+/// @brief Used until a part has been detected: the slowest of the above, field by field.
+static const EepromTiming EEPROM_TIMING_WORST_CASE = EEPROM_TIMING_AT28C;
+
+static const ChipInfo CHIP_TABLE[] = {
+  { "SST39SF010A", CHIP_FAMILY_SST, 0xBF, 0xB5, 131072, 4096, 0, 14, 20, 18000, 25000, 70000, 100000, EEPROM_TIMING_SST39SF },
+  { "SST39SF020A", CHIP_FAMILY_SST, 0xBF, 0xB6, 262144, 4096, 0, 14, 20, 18000, 25000, 70000, 100000, EEPROM_TIMING_SST39SF },
+  { "SST39SF040",  CHIP_FAMILY_SST, 0xBF, 0xB7, 524288, 4096, 0, 14, 20, 18000, 25000, 70000, 100000, EEPROM_TIMING_SST39SF },
+  { "AM29F010",    CHIP_FAMILY_AMD, 0x01, 0x20, 131072, 16384, 0, 7, 300, 1000000, 8000000, 8000000, 64000000, EEPROM_TIMING_AM29F },
+  { "AM29F040",    CHIP_FAMILY_AMD, 0x01, 0xA4, 524288, 65536, 0, 7, 300, 1000000, 8000000, 8000000, 64000000, EEPROM_TIMING_AM29F },
+  { "MBM29F040",   CHIP_FAMILY_AMD, 0x04, 0xA4, 524288, 65536, 0, 7, 300, 1000000, 8000000, 8000000, 64000000, EEPROM_TIMING_AM29F },
+  // Selected by hand, see chipLookup(). The AT28C256 needs the usual 28 to 32 pin JEDEC adapter.
+  { "AT28C256",    CHIP_FAMILY_ATMEL, 0x1F, 0x00, 32768, 4096, 64, 5000, 10000, 320000, 640000, 2560000, 5120000, EEPROM_TIMING_AT28C },
+  { "AT28C010",    CHIP_FAMILY_ATMEL, 0x1F, 0x00, 131072, 4096, 128, 5000, 10000, 160000, 320000, 5120000, 10240000, EEPROM_TIMING_AT28C },
+};
+
+#define CHIP_TABLE_LENGTH (sizeof(CHIP_TABLE) / sizeof(CHIP_TABLE[0]))
+
+/// @brief chipLookup() finds the part with these IDs. The Atmel parts are never matched, they
+///        have no Software ID so their entries only hold the JEDEC manufacturer code.
+/// @return the entry, or NULL for an unknown part
+static inline const ChipInfo* chipLookup(uint8_t manufacturerId, uint8_t deviceId) {
+  for (size_t i = 0; i < CHIP_TABLE_LENGTH; i++) {
+    if (CHIP_TABLE[i].family == CHIP_FAMILY_ATMEL) {
+      continue;
+    }
+    if (CHIP_TABLE[i].manufacturerId == manufacturerId && CHIP_TABLE[i].deviceId == deviceId) {
+      return &CHIP_TABLE[i];
+    }
+  }
+  return NULL;
+}
+
+#endif
@@ -36,12 +36,30 @@
 
 #include <stdint.h>
 #include <string.h>
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
 #include "hardware/i2c.h"
+#include "hardware/pio.h"
+#include "hardware/spi.h"
+#include "hardware/sync.h"
+#include "pico/multicore.h"
 #include "pico/stdlib.h"
 #include "stdio.h"
 #include "./lib/ssd1306/ssd1306.h" // OLED lib:
 #include "ff.h" // SD card lib
 #include "sd_card.h" // SD card lib
+#include "hw_config.h" // SD card lib, our spi0 / card setup in hw_config.c
+#include "diskio.h" // FatFs disk_read(), for the SD clock self-test
+#include "bus_queue.h" // core0 -> core1 bus command queue
+#include "bus_timing.h" // Datasheet timing in ns, converted to cycles
+#include "calibration_store.h" // Calibrated bus timing, kept in the Pico's flash
+#include "chip_table.h" // Supported parts, by Software Product ID
+#include "sd_stream.h" // Double-buffered SD file reader
+#include "block_pool.h" // The 4KB blocks image data travels to core1 in
+#include "shift_register.pio.h" // Generated from shift_register.pio
+#include "bus_read.pio.h" // Generated from bus_read.pio
+#include "bulk_program.pio.h" // Generated from bulk_program.pio
+#include "bus_sequence.h" // Fixed command sequences, built at compile time
 
 // Shift register pins:
 const int DATA_PIN_NUMBER = 2;
@@ -49,8 +67,87 @@ const int LATCH_PIN_NUMBER = 3;
 const int CLOCK_PIN_NUMBER = 4;
 const int ADDRESS_LINES = 24; // Rename.. this is 8 * number of shift registers
 
+// Shift register backends. The PIO backend clocks the address out in hardware,
+// the bit-banged backend is kept as a fallback (and for comparison).
+typedef enum {
+  SHIFT_BACKEND_BITBANG,
+  SHIFT_BACKEND_PIO
+} ShiftBackend;
+
+ShiftBackend shiftBackend = SHIFT_BACKEND_PIO;
+PIO SHIFT_PIO = pio0;
+uint shiftPioSm = 0;
+uint shiftPioOffset = 0;
+// 74HC595 at 4.5V: 16ns min clock pulse width and 16ns data setup, so it is good for ~25MHz.
+// Our DATA / CLOCK / LATCH inputs are driven at 3.3V though, which is right at the edge of
+// the 3.15V VIH spec, so we run it well below the datasheet maximum.
+const uint32_t SHIFT_REGISTER_CLOCK_HZ = 4000000;
+uint32_t shiftClockHz = SHIFT_REGISTER_CLOCK_HZ; // What the PIO programs run at, calibration can raise it
+
+// Pipelined bus mode: the 74HC595 outputs only change on the LATCH edge, so the next address can
+// be shifted in while the current one is still being read from or programmed.
+bool pipelinedBus = true;
+bool addressPreloaded = false; // True if preloadedAddress is sitting in the shift stage
+uint32_t preloadedAddress = 0;
+bool addressLatched = false; // True if latchedAddress is on the address lines, so it needs no shift
+uint32_t latchedAddress = 0;
+
+// Sequential read engine: bus_read.pio generates the addresses itself and DMA copies the
+// bytes out of its RX FIFO, so whole blocks get read without the CPU. It shares the shift
+// register pins with the shift_register program, only one of them runs at a time.
+uint busReadSm = 0;
+uint busReadOffset = 0;
+uint busReadDma = 0;
+pio_sm_config busReadConfig;
+dma_channel_config busReadDmaConfig;
+bool busReadRunning = false;
+uint32_t busReadNextAddress = 0; // The address the engine will deliver next
+// Bulk program engine: bulk_program.pio puts whole runs of byte programs on the bus, polling
+// included, fed from a buffer of words by DMA. The CPU only builds the words, with the unlock
+// cycles precompiled in bus_sequence.h. It needs a PIO of its own, and takes every bus pin over
+// while it runs. Socket 0 only, and only the flash parts.
+PIO BULK_PIO = pio1;
+uint bulkProgramSm = 0;
+uint bulkProgramOffset = 0;
+uint bulkProgramDma = 0;
+dma_channel_config bulkProgramDmaConfig;
+bool bulkProgramEngine = true; // Off falls back to the CPU driving every cycle
+#define BULK_PROGRAM_CHUNK 256 // Bytes per buffer of words, one is built while the other runs
+
+// The datasheet timing busTiming is worked out from: the part in the socket, or the worst case of
+// every supported part until one has been detected. useChipTiming() keeps it in step with chip.
+const EepromTiming* eepromTiming = &EEPROM_TIMING_WORST_CASE;
+uint32_t readAccessNs = 0; // busReadAccessNs() of eepromTiming, calibration can lower it
+
+// Bus timing calibration: the sweeps look for the fastest timing that still passes on this
+// board, then back off by this much so temperature and supply changes don't push it over.
+// At least calibrationMinMarginPercent of the datasheet value is always added on top, so a
+// setting that passed at (or near) 0 still gets some margin.
+uint32_t calibrationMarginPercent = 25;
+uint32_t calibrationMinMarginPercent = 25;
+BusCalibration busCalibration; // The one in use, applyBusCalibration() keeps it
+const int CALIBRATION_PASSES = 3;            // Reads of the pattern that must all match
+const uint32_t CALIBRATION_PROGRAM_BYTES = 256; // Bytes programmed per /WE pulse width tried
+
 // ROM data:
-const int MAX_EEPROM_ADDRESS_SPACE = 524288; // 2 ^ 19 : we have 19 address lines A0 -> A18
+#define EEPROM_SECTOR_SIZE 4096 // The 39SF0X0 erases in 4KB sectors
+#define MAX_EEPROM_SECTORS 128 // 524288 / 4096, the largest part we support
+#define NO_NEXT_ADDRESS 0xFFFFFFFFu // For writeSequence(): nothing to shift in ahead of time
+
+// The part in the socket, set by EEPROM_detectChip(). Everything that walks the chip sizes itself
+// from this, see chip_table.h. Parts without a Software ID have to be picked by hand (manualChip),
+// never guessed: the Software ID entry sequence would be three ordinary byte writes to them.
+const ChipInfo* chip = NULL;
+const ChipInfo* manualChip = NULL;
+const ChipInfo* timingChip = NULL; // The part eepromTiming belongs to
+
+// Page write parts (AT28C) only: put the software data protection sequence in front of every page
+// write, which also turns protection on if it was off. Turning this off sends the disable sequence.
+bool softwareDataProtection = true;
+#define MAX_PAGE_SIZE 256
+const char* ROM_FILE_NAME = "marioduck.nes";
+const char* DUMP_FILE_NAME = "dump.bin"; // Written by 'o', replaced every time
+const char* SOCKET_FILE_NAMES[] = { "socket0.bin", "socket1.bin", "socket2.bin", "socket3.bin" }; // One per socket, see 'x'
 
 // EEPROM Pins:
 const int WRITE_ENABLE_PIN = 28;
@@ -65,6 +162,80 @@ const int D5_PIN = 13;
 const int D6_PIN = 14;
 const int D7_PIN = 15;  // Why is 15 labeled as DO_NOT_USE ??
 
+// Gang programming: more sockets wired in parallel on the address, data, /OE and /WE lines, each
+// with its own /CE. Socket 0 is the one on the board (CHIP_ENABLE_PIN), the rest are on spare GPIOs.
+// A write cycle lowers /CE on every socket in writeSockets, so they all latch it. Anything with /OE
+// low only ever lowers readSocket's /CE, two chips must never drive the data bus at once.
+#define MAX_SOCKETS BUS_MAX_SOCKETS
+const int SOCKET_CHIP_ENABLE_PINS[MAX_SOCKETS] = { 26, 5, 6, 7 };
+uint32_t socketCount = 1;       // Sockets fitted, see 'n'
+uint32_t writeSockets = 0x1;    // One bit per socket
+uint32_t readSocket = 0;
+uint32_t writeChipEnableMask = 1u << 26; // GPIO masks for the above, kept by selectSockets()
+uint32_t readChipEnableMask = 1u << 26;
+uint32_t allChipEnableMask = 1u << 26;
+
+// Bus HAL backends. The SIO backend reads and writes D0 - D7 (which must be contiguous) and
+// the control lines with one masked SIO register access each, the per-pin backend calls
+// gpio_put() / gpio_get() once per pin and is kept for comparison.
+typedef enum {
+  BUS_HAL_PER_PIN,
+  BUS_HAL_SIO
+} BusHal;
+
+BusHal busHal = BUS_HAL_SIO;
+
+// Control lines for setControlLines(). These are the lines to assert (drive low), any not
+// listed are driven high.
+typedef enum {
+  BUS_CE = 0x1, // /CE
+  BUS_OE = 0x2, // /OE
+  BUS_WE = 0x4  // /WE
+} ControlLine;
+
+// Program / erase completion detection. The 39SF0X0 reports an internal program or
+// erase in progress on DQ7 (Data# polling: the complement of the written bit 7) and on
+// DQ6 (Toggle bit: alternates between consecutive reads). Either can be used.
+typedef enum {
+  POLL_DATA_BAR,
+  POLL_TOGGLE_BIT
+} CompletionPollMode;
+
+CompletionPollMode completionPollMode = POLL_DATA_BAR;
+// AMD parts only: while in unlock bypass mode a byte program is two bus cycles instead of four.
+// Only byte programs (and reads) may be issued until it is left again.
+bool unlockBypass = false;
+
+// How far past the datasheet maximum (see chip_table.h) to wait before giving up:
+const uint32_t PROGRAM_TIMEOUT_FACTOR = 10;
+const uint32_t ERASE_TIMEOUT_FACTOR = 5;
+
+// How EEPROM_WriteCurrentFile() programs each byte. Bit-compatible mode reads every byte
+// first, skips it if it already matches, programs it in place if only 1 -> 0 changes are
+// needed, and otherwise defers the byte to a sector erase at the end.
+typedef enum {
+  PROGRAM_ALL,
+  PROGRAM_BIT_COMPATIBLE
+} ProgramMode;
+
+ProgramMode programMode = PROGRAM_BIT_COMPATIBLE;
+
+// Inline verify: compare the byte read back at the end of each program cycle against the
+// byte just written, so programming and verifying take a single pass over the file.
+bool inlineVerify = true;
+uint8_t lastCompletedData = 0xFF; // The byte read back once the last program / erase completed
+
+// Mismatches found while inline verifying, kept for the final report:
+#define MAX_RECORDED_MISMATCHES 16
+typedef struct {
+  uint32_t address;
+  uint8_t expected;
+  uint8_t actual;
+} ByteMismatch;
+
+ByteMismatch recordedMismatches[MAX_RECORDED_MISMATCHES];
+uint32_t mismatchCount = 0;
+
 // Misc Pins:
 const int ONBOARD_LED_PIN = 25;
 
@@ -79,6 +250,23 @@ const uint8_t OLED_I2C_ADDRESS = 0x3C;
 const uint32_t OLED_TEXT_SCALE = 1;
 ssd1306_t _display;
 
+// Core1 bus engine. While a file is being streamed, core1 owns the EEPROM bus and works through
+// commands from core0, which keeps the SD card busy reading the next buffer in the meantime.
+BusQueue busCommands; // core0 -> core1
+BusQueue busResults;  // core1 -> core0
+static SDStream imageStream; // Its 4KB pool blocks get handed to core1 and back
+
+// Counters kept by the bus engine. Only read them on core0 once all results are back.
+typedef struct {
+  uint32_t matchedBytes;    // Bit-compatible mode: already correct, skipped
+  uint32_t programmedBytes; // Byte programs issued
+  uint32_t verifiedBytes;   // Bytes compared by BUS_CMD_VERIFY
+  uint64_t busyUs;          // Time spent running commands
+} BusStats;
+
+BusStats busStats;
+bool busInReadMode = false; // Kept up to date by setReadMode() / setWriteMode()
+
 /* SD CARD: See https://github.com/carlk3/no-OS-FatFS-SD-SPI-RPi-Pico?tab=readme-ov-file
  Physical Pin 24 (GPIO 18): CLOCK
  Physical Pin 21 (GPIO 16): MISO
@@ -86,22 +274,56 @@ ssd1306_t _display;
  Physical Pin 22 (GPIO 17): CS
  */
 
-// This int is used to perform a nop
-int dummy = 0;
-
-// nop() : same idea as a NOP assembly instruction (but slightly longer)
-// TODO: this could use a lot of improvement... see readme on github.
-void nop() {
-  dummy += 1;
-  for (int i = 0; i < 200; i++) {
-    dummy += 1;
+// SD SPI clocks to try, slowest first. The first is the safe rate the card is mounted at (see
+// hw_config.c), SD_negotiateClock() steps up from there. spi0 can only divide clk_peri by an even
+// number, so the clock actually used can be lower than asked for; spi_set_baudrate() reports it.
+// 25 MHz is the most SPI mode allows in default speed, and nothing here switches the card to high
+// speed (CMD6), so faster clocks are out of spec even on cards that happen to pass the self-test.
+const uint32_t SD_CLOCK_RATES_HZ[] = { 1000000, 12500000, 25000000 };
+#define SD_CLOCK_RATE_COUNT (sizeof(SD_CLOCK_RATES_HZ) / sizeof(SD_CLOCK_RATES_HZ[0]))
+#define SD_SELF_TEST_SECTORS 8   // One multi-block read (CMD18) of a 4KB pool block
+#define SD_SELF_TEST_PASSES 16   // Reads of it at each clock, each CRC checked by the driver
+#define SD_BENCHMARK_BYTES (256 * 1024) // Per clock, 2 seconds at the safe rate
+uint32_t sdClockIndex = 0; // Into SD_CLOCK_RATES_HZ
+
+#if !FF_USE_FASTSEEK || !FF_USE_EXPAND
+#warning "FatFs is built without fast seek or f_expand(), is ffconf.h from this project in use?"
+#endif
+
+#if FF_USE_FASTSEEK
+// Cluster link map tables for FatFs fast seek, one per image open at a time. Only the image opened
+// with SD_openFile() seeks, the interleaved writes read their files straight through. Each fragment
+// of a file takes 2 entries, plus 1 for the length and 1 to end the map: 15 fragments, far more
+// than a 512KB image has on any sane card.
+#define SD_LINK_MAP_LENGTH 32
+#define SD_LINK_MAP_TABLES 1
+static DWORD sdLinkMaps[SD_LINK_MAP_TABLES][SD_LINK_MAP_LENGTH];
+uint32_t sdLinkMapsInUse = 0; // One bit per table
+#endif
+
+// Every wait between bus edges, in cycles at the current clk_sys. Filled in by setup().
+BusTiming busTiming;
+
+/// @brief busWait() busy waits for at least the given number of cycles, see busTiming.
+/// @param cycles - cycles to wait
+static inline void busWait(uint32_t cycles) {
+  if (cycles > 0) {
+    busy_wait_at_least_cycles(cycles);
   }
 }
  
+void setShiftBackend(ShiftBackend backend);
+void busEngineMain();
+void setWriteMode();
+void selectSockets(uint32_t sockets, uint32_t socket);
+void applyBusCalibration(const BusCalibration* calibration);
+void datasheetCalibration(BusCalibration* calibration);
+
 /// @brief setup() is essentially following the Arduino pattern.
 ///        The main() function should first call setup, then loop() the main app logic.
 void setup() {
   stdio_init_all();
+  busTimingInit(&busTiming, clock_get_hz(clk_sys), eepromTiming);
 
   // Onboard LED:
   gpio_init(ONBOARD_LED_PIN);
@@ -139,6 +361,16 @@ void setup() {
   gpio_put(OUTPUT_ENABLE_PIN, true);
   gpio_put(CHIP_ENABLE_PIN, false);
 
+  allChipEnableMask = 0;
+  for (int i = 0; i < MAX_SOCKETS; i++) { // The other sockets' /CE stay high until a gang job
+    allChipEnableMask |= 1u << SOCKET_CHIP_ENABLE_PINS[i];
+    if (SOCKET_CHIP_ENABLE_PINS[i] == CHIP_ENABLE_PIN) { continue; }
+    gpio_init(SOCKET_CHIP_ENABLE_PINS[i]);
+    gpio_set_dir(SOCKET_CHIP_ENABLE_PINS[i], GPIO_OUT);
+    gpio_put(SOCKET_CHIP_ENABLE_PINS[i], true);
+  }
+  selectSockets(0x1, 0);
+
   gpio_init(D0_PIN);
   gpio_init(D1_PIN);
   gpio_init(D2_PIN);
@@ -147,16 +379,90 @@ void setup() {
   gpio_init(D5_PIN);
   gpio_init(D6_PIN);
   gpio_init(D7_PIN);
+  // The pulls stay configured from here on, so turning the data bus around only changes direction:
+  const int dataPins[] = { D0_PIN, D1_PIN, D2_PIN, D3_PIN,
+                           D4_PIN, D5_PIN, D6_PIN, D7_PIN };
+  for (int i = 0; i < 8; i++) {
+    gpio_pull_down(dataPins[i]);
+  }
+
+  // Load the PIO shift program, and hand the shift register pins to whichever backend is selected:
+  shiftPioOffset = pio_add_program(SHIFT_PIO, &shift_register_program);
+  shiftPioSm = pio_claim_unused_sm(SHIFT_PIO, true);
+  shift_register_program_init(SHIFT_PIO, shiftPioSm, shiftPioOffset, DATA_PIN_NUMBER,
+                              LATCH_PIN_NUMBER, SHIFT_REGISTER_CLOCK_HZ);
+  setShiftBackend(shiftBackend);
+
+  // Load the sequential read engine next to it:
+  busReadOffset = pio_add_program(SHIFT_PIO, &bus_read_program);
+  busReadSm = pio_claim_unused_sm(SHIFT_PIO, true);
+  busReadConfig = bus_read_program_config(busReadOffset, DATA_PIN_NUMBER, LATCH_PIN_NUMBER,
+                                          D0_PIN, SHIFT_REGISTER_CLOCK_HZ);
+  pio_sm_set_consistent_pindirs(SHIFT_PIO, busReadSm, DATA_PIN_NUMBER, 3, true); // DATA, LATCH, CLOCK
+  busReadDma = dma_claim_unused_channel(true);
+  busReadDmaConfig = dma_channel_get_default_config(busReadDma);
+  channel_config_set_transfer_data_size(&busReadDmaConfig, DMA_SIZE_32);
+  channel_config_set_read_increment(&busReadDmaConfig, false);
+  channel_config_set_write_increment(&busReadDmaConfig, true);
+  channel_config_set_dreq(&busReadDmaConfig, pio_get_dreq(SHIFT_PIO, busReadSm, false));
+
+  // The bulk program engine doesn't fit next to the other two programs:
+  bulkProgramOffset = pio_add_program(BULK_PIO, &bulk_program_program);
+  bulkProgramSm = pio_claim_unused_sm(BULK_PIO, true);
+  bulkProgramDma = dma_claim_unused_channel(true);
+  bulkProgramDmaConfig = dma_channel_get_default_config(bulkProgramDma);
+  channel_config_set_transfer_data_size(&bulkProgramDmaConfig, DMA_SIZE_32);
+  channel_config_set_read_increment(&bulkProgramDmaConfig, true);
+  channel_config_set_write_increment(&bulkProgramDmaConfig, false);
+  channel_config_set_dreq(&bulkProgramDmaConfig, pio_get_dreq(BULK_PIO, bulkProgramSm, true));
+
+  BusCalibration calibration; // Use this board's own timing if it has been calibrated
+  if (!calibrationLoad(&calibration)) {
+    datasheetCalibration(&calibration);
+  }
+  applyBusCalibration(&calibration);
+
+  setWriteMode(); // The bus engine expects the bus to start out in one mode or the other
+
+  // Start the bus engine on core1:
+  busQueueInit(&busCommands);
+  busQueueInit(&busResults);
+  multicore_launch_core1(busEngineMain);
 }
 
-/// @brief shiftAddress(uint32_t addr) shifts out the address specified
-/// @param addr The address to set
-void shiftAddress(uint32_t addr) {
+/// @brief setShiftBackend() selects how addresses get shifted out, and gives the
+///        DATA / LATCH / CLOCK pins to either the PIO block or plain GPIO (SIO).
+/// @param backend The backend to use from now on
+void setShiftBackend(ShiftBackend backend) {
+  const int pins[] = { DATA_PIN_NUMBER, LATCH_PIN_NUMBER, CLOCK_PIN_NUMBER };
+  if (backend == SHIFT_BACKEND_PIO) {
+    for (int i = 0; i < 3; i++) {
+      pio_gpio_init(SHIFT_PIO, pins[i]);
+    }
+    pio_sm_set_enabled(SHIFT_PIO, shiftPioSm, true);
+  } else {
+    pio_sm_set_enabled(SHIFT_PIO, shiftPioSm, false);
+    for (int i = 0; i < 3; i++) {
+      gpio_init(pins[i]);
+      gpio_set_dir(pins[i], GPIO_OUT);
+    }
+  }
+
+  if (backend != shiftBackend) {
+    addressPreloaded = false;
+    addressLatched = false;
+  }
+  shiftBackend = backend;
+}
+
+/// @brief shiftBitsBitBang(uint32_t addr) clocks the address into the shift stage one GPIO toggle
+///        at a time, without latching it onto the outputs.
+/// @param addr The address to shift in
+void shiftBitsBitBang(uint32_t addr) {
   gpio_put(LATCH_PIN_NUMBER, false);
   gpio_put(DATA_PIN_NUMBER, false);
   gpio_put(CLOCK_PIN_NUMBER, false);
 
-  bool state = false;
   for (int i = 0; i < ADDRESS_LINES; i++) {
     bool one = (addr & 0x01) != 0;
     addr >>= 1;
@@ -165,17 +471,205 @@ void shiftAddress(uint32_t addr) {
     } else {
       gpio_put(DATA_PIN_NUMBER, false);
     }
-    nop();
+    busWait(busTiming.shiftDataSetup);
     gpio_put(CLOCK_PIN_NUMBER, true);
-    nop();
+    busWait(busTiming.shiftClockWidth);
     gpio_put(CLOCK_PIN_NUMBER, false);
-    nop();
+    busWait(busTiming.shiftClockWidth);
   }
+}
 
+/// @brief latchBitBang() pulses LATCH, moving the shift stage onto the address lines.
+void latchBitBang() {
   gpio_put(LATCH_PIN_NUMBER, true);
-  nop();
+  busWait(busTiming.shiftClockWidth);
   gpio_put(LATCH_PIN_NUMBER, false);
-  nop();
+}
+
+/// @brief shiftAddressBitBang(uint32_t addr) shifts out and latches the address one GPIO toggle at a time.
+/// @param addr The address to set
+void shiftAddressBitBang(uint32_t addr) {
+  shiftBitsBitBang(addr);
+  latchBitBang();
+}
+
+/// @brief shiftPioWaitIdle() waits until the shift_register PIO program has finished every word
+///        pushed to it, and is back waiting at 'pull'.
+void shiftPioWaitIdle() {
+  const uint32_t txStall = 1u << (PIO_FDEBUG_TXSTALL_LSB + shiftPioSm);
+  SHIFT_PIO->fdebug = txStall; // Clear the stall flag, the SM sets it again once it is back at 'pull'
+  while (!pio_sm_is_tx_fifo_empty(SHIFT_PIO, shiftPioSm) || (SHIFT_PIO->fdebug & txStall) == 0) {
+    tight_loop_contents();
+  }
+}
+
+/// @brief shiftAddressPio(uint32_t addr) hands the address to the shift_register PIO program,
+///        and waits until it has been shifted and latched so the address lines are valid on return.
+/// @param addr The address to set
+void shiftAddressPio(uint32_t addr) {
+  pio_sm_put_blocking(SHIFT_PIO, shiftPioSm, SHIFT_WORD(addr, SHIFT_FLAG_SHIFT | SHIFT_FLAG_LATCH));
+  shiftPioWaitIdle();
+}
+
+/// @brief busReadStop() stops the sequential read engine and gives the shift register pins
+///        back to the selected shift backend.
+void busReadStop() {
+  dma_channel_abort(busReadDma);
+  pio_sm_set_enabled(SHIFT_PIO, busReadSm, false);
+  pio_sm_clear_fifos(SHIFT_PIO, busReadSm);
+  busReadRunning = false;
+  setShiftBackend(shiftBackend);
+}
+
+/// @brief busReadStart() starts the sequential read engine at startAddress. The EEPROM must be in
+///        read mode (/CE and /OE low) already.
+/// @param startAddress The first address to read
+void busReadStart(uint32_t startAddress) {
+  const int pins[] = { DATA_PIN_NUMBER, LATCH_PIN_NUMBER, CLOCK_PIN_NUMBER };
+  if (busReadRunning) {
+    busReadStop();
+  }
+
+  if (shiftBackend == SHIFT_BACKEND_PIO) {
+    shiftPioWaitIdle();
+  }
+  pio_sm_set_enabled(SHIFT_PIO, shiftPioSm, false);
+  for (int i = 0; i < 3; i++) {
+    pio_gpio_init(SHIFT_PIO, pins[i]);
+  }
+  addressPreloaded = false;
+  addressLatched = false; // The engine walks the address lines on its own
+
+  // The engine samples BUS_READ_CYCLES_AFTER_LATCH + loops state machine cycles after the latch
+  // edge, so the loops only need to cover whatever part of tACC the next shift doesn't.
+  uint32_t smPeriodNs = 1000000000u / (shiftClockHz * BUS_READ_CYCLES_PER_BIT);
+  uint32_t accessCycles = (readAccessNs + smPeriodNs - 1) / smPeriodNs;
+  uint32_t accessLoops = accessCycles > BUS_READ_CYCLES_AFTER_LATCH ? accessCycles - BUS_READ_CYCLES_AFTER_LATCH : 0;
+  accessLoops = accessLoops > 255 ? 255 : accessLoops;
+  pio_sm_init(SHIFT_PIO, busReadSm, busReadOffset, &busReadConfig);
+  pio_sm_put(SHIFT_PIO, busReadSm, (accessLoops << 24) | startAddress);
+  pio_sm_set_enabled(SHIFT_PIO, busReadSm, true);
+  busReadRunning = true;
+  busReadNextAddress = startAddress;
+}
+
+/// @brief setShiftClock() changes the shift register clock of both PIO programs.
+/// @param hz The new shift clock
+void setShiftClock(uint32_t hz) {
+  if (busReadRunning) {
+    busReadStop();
+  }
+  if (shiftBackend == SHIFT_BACKEND_PIO) {
+    shiftPioWaitIdle();
+  }
+
+  shiftClockHz = hz;
+  float div = (float)clock_get_hz(clk_sys) / (float)(hz * SHIFT_REGISTER_CYCLES_PER_BIT);
+  pio_sm_set_clkdiv(SHIFT_PIO, shiftPioSm, div < 1.0f ? 1.0f : div);
+  busReadConfig = bus_read_program_config(busReadOffset, DATA_PIN_NUMBER, LATCH_PIN_NUMBER, D0_PIN, hz);
+}
+
+/// @brief chipCalibrationId() identifies a part for BusCalibration.chipId. The AT28C parts share
+///        their IDs, so the size goes in as well.
+uint32_t chipCalibrationId(const ChipInfo* part) {
+  return ((uint32_t)part->manufacturerId << 24) | ((uint32_t)part->deviceId << 16) | (part->size >> 12);
+}
+
+/// @brief applyBusCalibration() switches to calibrated timing, the rest stays at the datasheet values
+///        of eepromTiming. A calibration measured on the other shift backend or on another part is
+///        kept, but the datasheet timing is used until that backend and part are back.
+/// @param calibration The timing to use
+void applyBusCalibration(const BusCalibration* calibration) {
+  if (calibration != &busCalibration) {
+    busCalibration = *calibration;
+  }
+  busTimingInit(&busTiming, clock_get_hz(clk_sys), eepromTiming);
+  readAccessNs = busReadAccessNs(eepromTiming);
+  if (calibration->shiftBackend == CALIBRATION_ANY_BACKEND || chip == NULL) {
+    setShiftClock(SHIFT_REGISTER_CLOCK_HZ);
+    return;
+  }
+  if (calibration->shiftBackend != shiftBackend || calibration->chipId != chipCalibrationId(chip)) {
+    printf("Bus timing: calibrated on another %s, using the %s datasheet timing.\n",
+           calibration->shiftBackend != shiftBackend ? "shift backend" : "part", chip->name);
+    setShiftClock(SHIFT_REGISTER_CLOCK_HZ);
+    return;
+  }
+  busTiming.writePulse = NS_TO_CYCLES(calibration->writePulseNs, busTiming.sysHz);
+  busTiming.readAccess = NS_TO_CYCLES(calibration->readAccessNs, busTiming.sysHz);
+  readAccessNs = calibration->readAccessNs;
+  setShiftClock(calibration->shiftClockHz);
+}
+
+/// @brief datasheetCalibration() fills in the uncalibrated, datasheet timing of eepromTiming.
+///        applyBusCalibration() works it out again for whichever part is detected later.
+/// @param calibration The calibration to fill in
+void datasheetCalibration(BusCalibration* calibration) {
+  BusTiming timing;
+  busTimingInit(&timing, clock_get_hz(clk_sys), eepromTiming);
+  memset(calibration, 0, sizeof(BusCalibration));
+  calibration->shiftClockHz = SHIFT_REGISTER_CLOCK_HZ;
+  calibration->writePulseNs = (uint32_t)(((uint64_t)timing.writePulse * 1000000000u + timing.sysHz - 1) / timing.sysHz);
+  calibration->readAccessNs = busReadAccessNs(eepromTiming);
+  calibration->shiftBackend = CALIBRATION_ANY_BACKEND;
+}
+
+/// @brief useChipTiming() switches the bus timing over to the part in chip, or back to the worst
+///        case when there is none. Nothing happens unless the part changed, so it is cheap to call
+///        after every detection.
+void useChipTiming() {
+  if (chip == timingChip) {
+    return;
+  }
+  timingChip = chip;
+  eepromTiming = chip != NULL ? &chip->timing : &EEPROM_TIMING_WORST_CASE;
+  applyBusCalibration(&busCalibration);
+}
+
+/// @brief shiftAddressPreload(uint32_t addr) shifts the address into the 74HC595 shift stage without
+///        latching it, so the address currently on the outputs stays put. The next shiftAddress()
+///        of the same address then only needs a latch pulse. With the PIO backend this returns
+///        right away and the shift happens in the background.
+/// @param addr The address to shift in
+void shiftAddressPreload(uint32_t addr) {
+  if (busReadRunning) { // The read engine owns the shift registers, take them back
+    busReadStop();
+  }
+
+  if (shiftBackend == SHIFT_BACKEND_PIO) {
+    pio_sm_put_blocking(SHIFT_PIO, shiftPioSm, SHIFT_WORD(addr, SHIFT_FLAG_SHIFT));
+  } else {
+    shiftBitsBitBang(addr);
+  }
+  addressPreloaded = true;
+  preloadedAddress = addr;
+}
+
+/// @brief shiftAddress(uint32_t addr) shifts out the address specified
+/// @param addr The address to set
+void shiftAddress(uint32_t addr) {
+  if (busReadRunning) { // The read engine owns the shift registers, take them back
+    busReadStop();
+  }
+
+  if (addressLatched && latchedAddress == addr) {
+    return; // Already there, e.g. the two cycles of an unlock bypass program
+  }
+
+  bool latchOnly = addressPreloaded && preloadedAddress == addr;
+  if (shiftBackend == SHIFT_BACKEND_PIO) {
+    if (latchOnly) {
+      pio_sm_put_blocking(SHIFT_PIO, shiftPioSm, SHIFT_WORD(0, SHIFT_FLAG_LATCH));
+      shiftPioWaitIdle();
+    } else {
+      shiftAddressPio(addr);
+    }
+  } else {
+    latchOnly ? latchBitBang() : shiftAddressBitBang(addr);
+  }
+  addressPreloaded = false;
+  addressLatched = true;
+  latchedAddress = addr;
 }
 
 /// @brief handleErr() is a function to blink the onboard LED and stop the pi if something went wrong.
@@ -212,7 +706,11 @@ void oledDisplayMessages(char *message1, char *message2, char *message3, char* m
 /// @brief sets each data pin according to the input byte
 /// @param byteOfData - the byte to set.
 void setDataPins(uint8_t byteOfData) {
-  bool state = false;
+  if (busHal == BUS_HAL_SIO) {
+    gpio_put_masked(0xFFu << D0_PIN, (uint32_t)byteOfData << D0_PIN);
+    return;
+  }
+
   const int pins[] = { D0_PIN, D1_PIN, D2_PIN, D3_PIN,
                       D4_PIN, D5_PIN, D6_PIN, D7_PIN };
   for (int i = 0; i < 8; i++) {  // This is always a byte, 8 bits.
@@ -222,61 +720,273 @@ void setDataPins(uint8_t byteOfData) {
   }
 }
 
-/// @brief // setReadMode() changes the data pins to inputs, and clears them if they were ON before that.
-///           it also preps the EEPROM control pins to prepare to output the data (and input into our Pi).
-void setReadMode() {
+/// @brief setControlLines() drives /CE, /OE and /WE. The SIO backend changes all three with
+///        one store. The per-pin backend releases lines before asserting any, and asserts
+///        /CE before /WE, so a write cycle is still /WE controlled.
+/// @param asserted - ControlLine flags for the lines to drive low, the rest go high.
+void setControlLines(uint32_t asserted) {
+  uint32_t chipEnable = (asserted & BUS_OE) ? readChipEnableMask : writeChipEnableMask;
+  if (busHal == BUS_HAL_SIO) {
+    uint32_t mask = allChipEnableMask | (1u << OUTPUT_ENABLE_PIN) | (1u << WRITE_ENABLE_PIN);
+    uint32_t low = ((asserted & BUS_CE) ? chipEnable : 0) |
+                   ((asserted & BUS_OE) ? 1u << OUTPUT_ENABLE_PIN : 0) |
+                   ((asserted & BUS_WE) ? 1u << WRITE_ENABLE_PIN : 0);
+    gpio_put_masked(mask, mask & ~low);
+    return;
+  }
+
+  if ((asserted & BUS_WE) == 0) { gpio_put(WRITE_ENABLE_PIN, true); }
+  if ((asserted & BUS_OE) == 0) { gpio_put(OUTPUT_ENABLE_PIN, true); }
+  for (int i = 0; i < MAX_SOCKETS; i++) { // Release first, so two sockets never overlap
+    if ((asserted & BUS_CE) == 0 || (chipEnable & (1u << SOCKET_CHIP_ENABLE_PINS[i])) == 0) {
+      gpio_put(SOCKET_CHIP_ENABLE_PINS[i], true);
+    }
+  }
+  for (int i = 0; (asserted & BUS_CE) != 0 && i < MAX_SOCKETS; i++) {
+    if ((chipEnable & (1u << SOCKET_CHIP_ENABLE_PINS[i])) != 0) {
+      gpio_put(SOCKET_CHIP_ENABLE_PINS[i], false);
+    }
+  }
+  if ((asserted & BUS_OE) != 0) { gpio_put(OUTPUT_ENABLE_PIN, false); }
+  if ((asserted & BUS_WE) != 0) { gpio_put(WRITE_ENABLE_PIN, false); }
+}
+
+/// @brief selectSockets() picks which sockets the bus talks to. Only call it with the bus idle
+///        (/OE and /WE high), and never while core1 is running a command.
+/// @param sockets One bit per socket, all of them latch write cycles
+/// @param socket The one socket that is read from
+void selectSockets(uint32_t sockets, uint32_t socket) {
+  writeSockets = sockets;
+  readSocket = socket;
+  writeChipEnableMask = 0;
+  for (int i = 0; i < MAX_SOCKETS; i++) {
+    writeChipEnableMask |= (sockets & (1u << i)) ? 1u << SOCKET_CHIP_ENABLE_PINS[i] : 0;
+  }
+  readChipEnableMask = 1u << SOCKET_CHIP_ENABLE_PINS[socket];
+}
+
+/// @brief setDataPinsDirection() flips D0 - D7 between outputs and inputs, without touching
+///        the control lines (unlike setReadMode() / setWriteMode()). Before driving the bus this
+///        waits tDF, in case /OE was only just released, the pull configuration is left alone.
+/// @param output - true to drive the data bus, false to let the EEPROM drive it.
+void setDataPinsDirection(bool output) {
+  if (output) {
+    busWait(busTiming.outputDisable);
+  }
+
+  if (busHal == BUS_HAL_SIO) {
+    gpio_set_dir_masked(0xFFu << D0_PIN, output ? 0xFFu << D0_PIN : 0);
+    return;
+  }
+
   const int pins[] = { D0_PIN, D1_PIN, D2_PIN, D3_PIN,
                       D4_PIN, D5_PIN, D6_PIN, D7_PIN };
   for (int i = 0; i < 8; i++) {
-    if (gpio_get_dir(pins[i]) == 1) {
-      gpio_put(pins[i], false);
-      sleep_ms(1);
-    }
-    gpio_set_dir(pins[i], GPIO_IN);
-    gpio_pull_down(pins[i]);
-    sleep_ms(1);
+    gpio_set_dir(pins[i], output ? GPIO_OUT : GPIO_IN);
   }
+}
 
-  gpio_put(WRITE_ENABLE_PIN, true);    // Set /WE to high (off)
-  gpio_put(OUTPUT_ENABLE_PIN, false);  // Set /OE to low (on)
-  gpio_put(CHIP_ENABLE_PIN, false);    // Set /CE to low (on)
+/// @brief // setReadMode() releases the data pins, and enables the EEPROM outputs so it drives them (and our Pi reads them).
+void setReadMode() {
+  setDataPinsDirection(false);
+  setControlLines(BUS_CE | BUS_OE); // /WE high (off), /OE and /CE low (on)
   // At this point, the outputs are always on, changing the address controls the data output.
-  sleep_ms(1);
+  busInReadMode = true;
 }
 
-/// @brief setWriteMode() sets the data pins to be outputs, and preps the EEPROM enable pins.
+/// @brief setWriteMode() disables the EEPROM outputs, then sets the data pins to be outputs.
 void setWriteMode() {
-  const int pins[] = { D0_PIN, D1_PIN, D2_PIN, D3_PIN,
-                      D4_PIN, D5_PIN, D6_PIN, D7_PIN };
-  for (int i = 0; i < 8; i++) {
-    gpio_set_dir(pins[i], GPIO_OUT);
-    gpio_put(pins[i], false);
+  if (busReadRunning) { // Never drive the data bus while the read engine has /OE low
+    busReadStop();
   }
 
-  gpio_put(OUTPUT_ENABLE_PIN, true);  // Set /OE to high (off)
-  gpio_put(CHIP_ENABLE_PIN, true);  // Set /CE to high (off)  - CE and WE must be kept high
-  gpio_put(WRITE_ENABLE_PIN, true);  // Set /WE to high.
-  sleep_ms(1);
+  setControlLines(0); // /OE, /CE and /WE high (off) - CE and WE must be kept high
+  setDataPins(0);
+  setDataPinsDirection(true); // Waits out tDF before driving the bus
+  busInReadMode = false;
+}
+
+/// @brief pulseWrite() runs the /CE and /WE part of a write cycle, once the address and data are set up.
+void pulseWrite() {
+  busWait(busTiming.addressSetup);
+  setControlLines(BUS_CE | BUS_WE); // The address is latched on this falling edge
+  busWait(busTiming.writePulse);
+  setControlLines(0); // And the data on this rising edge
+  busWait(busTiming.writePulseHigh);
 }
 
 /// @brief write(uint32_t address, uint8_t data) shifts out the address, then sets the
-///        data pins to match the input byte. Finally, we toggle /CE and /WE to perform the write.
+///        data pins to match the input byte. Finally, we pulse /CE and /WE together to perform the write.
+///        This is a single bus cycle only, it does not wait for any internal program operation
+///        to finish, see EEPROM_waitForCompletion() for that.
 /// @param address - The destination address
 /// @param data - The desired Byte to write
 void write(uint32_t address, uint8_t data) {
-  gpio_put(OUTPUT_ENABLE_PIN, true);
-  gpio_put(WRITE_ENABLE_PIN, true);
-  gpio_put(CHIP_ENABLE_PIN, false);
-  nop();
+  setControlLines(0);
   shiftAddress(address);
   setDataPins(data);
-  nop();
-  gpio_put(WRITE_ENABLE_PIN, false);
-  sleep_us(1); // This should be 20 nano seconds, but even doing 500 nop commands does not work...
-  gpio_put(WRITE_ENABLE_PIN, true);
-  sleep_us(1);
-  gpio_put(CHIP_ENABLE_PIN, true);
-  sleep_us(25); // According to datasheet, this can take up to 20 microseconds.
+  pulseWrite();
+}
+
+/// @brief writeSequence() puts one of the fixed command sequences from bus_sequence.h on the bus.
+///        With the PIO backend, the next cycle's precompiled word is handed to the PIO as soon as
+///        the current address is latched, so it shifts in during this cycle's /WE pulse and the
+///        next cycle only waits for a latch. The bit-banged backend just writes each cycle.
+/// @param sequence The cycles to write
+/// @param length Number of cycles
+/// @param nextAddress The address the caller writes next, shifted in during the last cycle,
+///        or NO_NEXT_ADDRESS
+void writeSequence(const BusCycle* sequence, uint32_t length, uint32_t nextAddress) {
+  for (uint32_t i = 0; i < length; i++) {
+    setControlLines(0);
+    shiftAddress(sequence[i].address);
+    setDataPins(sequence[i].data);
+    bool last = i + 1 == length;
+    if (shiftBackend == SHIFT_BACKEND_PIO && (!last || nextAddress != NO_NEXT_ADDRESS)) {
+      // Only the shift stage changes, the outputs hold this cycle's address until the next latch:
+      pio_sm_put_blocking(SHIFT_PIO, shiftPioSm,
+                          last ? SHIFT_WORD(nextAddress, SHIFT_FLAG_SHIFT) : sequence[i + 1].preloadWord);
+      addressPreloaded = true;
+      preloadedAddress = last ? nextAddress : sequence[i + 1].address;
+    }
+    pulseWrite();
+  }
+}
+
+/// @brief readDataPins() reads D0 - D7 into a byte. The caller is responsible for the control lines.
+/// @return uint8_t the byte currently on the data bus.
+uint8_t readDataPins() {
+  if (busHal == BUS_HAL_SIO) {
+    return (uint8_t)(gpio_get_all() >> D0_PIN);
+  }
+
+  uint8_t output = 0x0;
+  const int pins[] = { D7_PIN, D6_PIN, D5_PIN, D4_PIN,
+                      D3_PIN, D2_PIN, D1_PIN, D0_PIN };
+  for (int i = 0; i < 8; i++) {
+    output = output << 1 | (gpio_get(pins[i]) ? 1 : 0);
+  }
+
+  return output;
+}
+
+/// @brief pollRead() performs one status read cycle (/CE and /OE low) at the currently latched address.
+///        Every status read needs its own /OE falling edge for the toggle bit to advance.
+/// @return uint8_t the status byte
+uint8_t pollRead() {
+  setControlLines(BUS_CE | BUS_OE);
+  busWait(busTiming.outputEnable);
+  uint8_t status = readDataPins();
+  setControlLines(BUS_CE);
+  return status;
+}
+
+/// @brief EEPROM_readBack() reads a single byte while the data pins are in write mode,
+///        turning the data bus around just for this one read and back again.
+/// @param address The address to read from
+/// @return uint8_t data read from that address.
+uint8_t EEPROM_readBack(uint32_t address) {
+  shiftAddress(address);
+  setDataPinsDirection(false);
+  setControlLines(BUS_CE);
+  uint8_t data = pollRead();
+  setControlLines(0);
+  setDataPinsDirection(true);
+  return data;
+}
+
+/// @brief EEPROM_waitForCompletion() waits for an internal program or erase operation to finish,
+///        using Data# polling or the toggle bit depending on completionPollMode.
+///        The data pins must be in write mode when this is called, and are left that way.
+/// @param expected The byte that was programmed (0xFF for an erase), used for Data# polling.
+/// @param timeoutUs Give up after this many microseconds.
+/// @return true once the operation has completed, false if it timed out.
+bool EEPROM_waitForCompletion(uint8_t expected, uint32_t timeoutUs) {
+  setDataPinsDirection(false);
+  setControlLines(BUS_CE);
+
+  bool done = false;
+  bool exceededLimits = false;
+  uint64_t start = time_us_64();
+  uint8_t previous = pollRead();
+  while (true) {
+    uint8_t status = pollRead();
+    if (completionPollMode == POLL_DATA_BAR) {
+      done = ((status ^ expected) & 0x80) == 0; // DQ7 reads back true data once finished
+    } else {
+      done = ((status ^ previous) & 0x40) == 0; // DQ6 stops toggling once finished
+    }
+    previous = status;
+
+    if (!done && chip->family == CHIP_FAMILY_AMD && (status & 0x20) != 0) {
+      // DQ5: the part has given up. It may have finished at the same moment though, so look once more.
+      uint8_t recheck = pollRead();
+      done = completionPollMode == POLL_DATA_BAR ? ((recheck ^ expected) & 0x80) == 0
+                                                 : ((recheck ^ status) & 0x40) == 0;
+      exceededLimits = !done;
+    }
+
+    if (done || exceededLimits || (time_us_64() - start) > timeoutUs) {
+      break;
+    }
+  }
+
+  if (done) {
+    lastCompletedData = pollRead(); // DQ7 can flip a moment before the other bits are valid
+  }
+
+  setControlLines(0);
+  setDataPinsDirection(true);
+  if (exceededLimits) {
+    printf("Program / erase failed, the chip reported exceeding its timing limits (DQ5).\n");
+    write(0x0000, 0xF0); // Reset, back to reading array data
+  } else if (!done) {
+    printf("Timed out waiting for program / erase to complete after %lu us.\n", timeoutUs);
+  }
+
+  return done;
+}
+
+/// @brief The outcome of pollCompletion().
+typedef enum {
+  POLL_BUSY,
+  POLL_DONE,
+  POLL_FAILED // DQ5, the part gave up
+} PollResult;
+
+/// @brief pollCompletion() is a single non-blocking look at an internal program operation, see
+///        EEPROM_waitForCompletion(). On POLL_DONE the byte read back is in lastCompletedData.
+///        The data pins must be in write mode when this is called, and are left that way.
+/// @param address The address being programmed, Data# polling only works there
+/// @param expected The byte being programmed
+PollResult pollCompletion(uint32_t address, uint8_t expected) {
+  shiftAddress(address);
+  setDataPinsDirection(false);
+  setControlLines(BUS_CE);
+
+  uint8_t previous = pollRead();
+  uint8_t status = pollRead();
+  bool done = completionPollMode == POLL_DATA_BAR ? ((status ^ expected) & 0x80) == 0
+                                                  : ((status ^ previous) & 0x40) == 0;
+  bool exceededLimits = false;
+  if (!done && chip->family == CHIP_FAMILY_AMD && (status & 0x20) != 0) {
+    uint8_t recheck = pollRead();
+    done = completionPollMode == POLL_DATA_BAR ? ((recheck ^ expected) & 0x80) == 0
+                                               : ((recheck ^ status) & 0x40) == 0;
+    exceededLimits = !done;
+  }
+
+  if (done) {
+    lastCompletedData = pollRead();
+  }
+
+  setControlLines(0);
+  setDataPinsDirection(true);
+  if (exceededLimits) {
+    write(0x0000, 0xF0); // Reset, back to reading array data
+  }
+
+  return done ? POLL_DONE : exceededLimits ? POLL_FAILED : POLL_BUSY;
 }
 
 /// @brief EEPROM_readByte(uint32_t address) reads the data at the supplied address from EEPROM.
@@ -285,20 +995,201 @@ void write(uint32_t address, uint8_t data) {
 /// @param address The address to read from. 
 /// @return uint8_t data read from that address.
 uint8_t EEPROM_readByte(uint32_t address) {
-  uint8_t output = 0x0;
-  const int pins[] = { D7_PIN, D6_PIN, D5_PIN, D4_PIN,
-                      D3_PIN, D2_PIN, D1_PIN, D0_PIN };
-  uint8_t currentBit = 0;
-  bool currentBitState = false;
   shiftAddress(address);
-  nop();
-  for (int i = 0; i < 8; i++) {
-    currentBitState = gpio_get(pins[i]);
-    currentBit = currentBitState ? 1 : 0;
-    output = output << 1 | currentBit;
+  busWait(busTiming.readAccess);
+  return readDataPins();
+}
+
+/// @brief EEPROM_readBlockStart() starts reading length bytes from address into dest. With the PIO
+///        backend the read engine and DMA do the work and this returns straight away, so the caller
+///        can get on with something else until EEPROM_readBlockWait(). The bit-banged backend just
+///        reads the block before returning. The EEPROM must be in read mode.
+/// @param address The first address to read
+/// @param dest Where to put the data. Must be 4 byte aligned, with room to round length up to 4.
+/// @param length Number of bytes to read
+void EEPROM_readBlockStart(uint32_t address, uint8_t* dest, uint32_t length) {
+  if (shiftBackend != SHIFT_BACKEND_PIO && !pipelinedBus) {
+    for (uint32_t i = 0; i < length; i++) {
+      dest[i] = EEPROM_readByte(address + i);
+    }
+    return;
   }
 
-  return output;
+  if (shiftBackend != SHIFT_BACKEND_PIO) { // Pipelined: shift N + 1 in while N's data settles
+    shiftAddress(address);
+    for (uint32_t i = 0; i < length; i++) {
+      if (i + 1 < length) {
+        shiftAddressPreload(address + i + 1); // Takes longer than tACC
+      } else {
+        busWait(busTiming.readAccess);
+      }
+      dest[i] = readDataPins();
+      if (i + 1 < length) {
+        shiftAddress(address + i + 1); // Only a latch pulse now
+      }
+    }
+    return;
+  }
+
+  if (!busReadRunning || busReadNextAddress != address) {
+    busReadStart(address);
+  }
+
+  uint32_t words = (length + 3) / 4; // The engine delivers 4 bytes per FIFO word
+  dma_channel_configure(busReadDma, &busReadDmaConfig, dest, &SHIFT_PIO->rxf[busReadSm], words, true);
+  busReadNextAddress = address + words * 4;
+}
+
+/// @brief EEPROM_readBlockWait() waits for the block started by EEPROM_readBlockStart().
+void EEPROM_readBlockWait() {
+  if (busReadRunning) {
+    dma_channel_wait_for_finish_blocking(busReadDma);
+  }
+}
+
+/// @brief EEPROM_readBlock() reads length bytes from address into dest, see EEPROM_readBlockStart().
+void EEPROM_readBlock(uint32_t address, uint8_t* dest, uint32_t length) {
+  EEPROM_readBlockStart(address, dest, length);
+  EEPROM_readBlockWait();
+}
+
+/// @brief SD_setClock() switches spi0 to one of SD_CLOCK_RATES_HZ. The driver takes the rate from
+///        hw_config.c's spi_t whenever it (re)initializes the card, so that is updated too.
+/// @param index Into SD_CLOCK_RATES_HZ
+/// @return The clock actually set, in Hz
+uint32_t SD_setClock(uint32_t index) {
+  spi_t* spi = spi_get_by_num(0);
+  sdClockIndex = index;
+  spi->baud_rate = SD_CLOCK_RATES_HZ[index];
+  return spi_set_baudrate(spi->hw_inst, SD_CLOCK_RATES_HZ[index]);
+}
+
+/// @brief SD_selfTest() reads the first SD_SELF_TEST_SECTORS of the card SD_SELF_TEST_PASSES times
+///        at the current clock. The driver checks the CRC of every sector, and each pass has to
+///        match reference, read at the safe rate.
+/// @return true if every read passed
+bool SD_selfTest(const uint8_t* reference, uint8_t* buffer) {
+  for (uint32_t pass = 0; pass < SD_SELF_TEST_PASSES; pass++) {
+    if (disk_read(0, buffer, 0, SD_SELF_TEST_SECTORS) != RES_OK) {
+      return false;
+    }
+    if (memcmp(buffer, reference, SD_SELF_TEST_SECTORS * 512) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// @brief SD_negotiateClock() raises the SD clock from the safe rate one step at a time, and keeps
+///        the fastest rate that passes SD_selfTest(). The card must be mounted at the safe rate.
+void SD_negotiateClock() {
+  uint8_t* reference = blockPoolAcquire();
+  uint8_t* buffer = blockPoolAcquire();
+  if (buffer == NULL || disk_read(0, reference, 0, SD_SELF_TEST_SECTORS) != RES_OK) {
+    printf("SD clock: no self-test possible, staying at %lu Hz.\n", SD_CLOCK_RATES_HZ[0]);
+    blockPoolRelease(reference);
+    blockPoolRelease(buffer);
+    return;
+  }
+
+  uint32_t passed = 0;
+  for (uint32_t index = 1; index < SD_CLOCK_RATE_COUNT; index++) {
+    SD_setClock(index);
+    if (!SD_selfTest(reference, buffer)) { break; }
+    passed = index;
+  }
+  uint32_t hz = SD_setClock(passed);
+  printf("SD clock: %lu Hz (asked for %lu Hz).\n", hz, SD_CLOCK_RATES_HZ[passed]);
+  blockPoolRelease(reference);
+  blockPoolRelease(buffer);
+}
+
+/// @brief SD_slowDown() drops the SD clock one step after a read error, see sdStreamRead().
+/// @return false if it was already at the safe rate
+bool SD_slowDown() {
+  if (sdClockIndex == 0) {
+    return false;
+  }
+  uint32_t hz = SD_setClock(sdClockIndex - 1);
+  printf("SD Error! Read failed, retrying at %lu Hz.\n", hz);
+  return true;
+}
+
+/// @brief SD_fastSeek() gives a file opened for reading a cluster link map table, so seeking
+///        anywhere in it is a lookup in the table instead of walking the FAT chain from the start.
+///        With no free table, or a FatFs built without FF_USE_FASTSEEK, seeks walk the chain as before.
+/// @param fil The file, just opened
+void SD_fastSeek(FIL* fil) {
+#if FF_USE_FASTSEEK
+  fil->cltbl = NULL;
+  for (uint32_t i = 0; i < SD_LINK_MAP_TABLES; i++) {
+    if (sdLinkMapsInUse & (1u << i)) { continue; }
+
+    sdLinkMaps[i][0] = SD_LINK_MAP_LENGTH;
+    fil->cltbl = sdLinkMaps[i];
+    FRESULT fr = f_lseek(fil, CREATE_LINKMAP);
+    if (fr != FR_OK) { // FR_NOT_ENOUGH_CORE: too fragmented for the table
+      printf("SD: no fast seek for this file (%d, %lu entries needed).\n", fr, sdLinkMaps[i][0]);
+      fil->cltbl = NULL;
+      return;
+    }
+    sdLinkMapsInUse |= 1u << i;
+    return;
+  }
+#else
+  (void)fil;
+#endif
+}
+
+/// @brief SD_dropFastSeek() gives back the file's link map table, if it has one. Call before f_close.
+void SD_dropFastSeek(FIL* fil) {
+#if FF_USE_FASTSEEK
+  for (uint32_t i = 0; i < SD_LINK_MAP_TABLES; i++) {
+    if (fil->cltbl == sdLinkMaps[i]) {
+      sdLinkMapsInUse &= ~(1u << i);
+    }
+  }
+  fil->cltbl = NULL;
+#else
+  (void)fil;
+#endif
+}
+
+/// @brief SD_benchmarkSeek() times seeks to every 4KB sector of fil, last to first so FatFs can't
+///        just carry on from where it is, with and without the link map.
+void SD_benchmarkSeek(FIL* fil) {
+  uint32_t sectors = (uint32_t)((f_size(fil) + EEPROM_SECTOR_SIZE - 1) / EEPROM_SECTOR_SIZE);
+  if (sectors == 0) { return; }
+
+#if FF_USE_FASTSEEK
+  DWORD* linkMap = fil->cltbl;
+  bool haveLinkMap = linkMap != NULL;
+#else
+  bool haveLinkMap = false;
+#endif
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    if (pass == 1 && !haveLinkMap) {
+      printf("  fast seek: off (no link map for this file)\n");
+      break;
+    }
+#if FF_USE_FASTSEEK
+    fil->cltbl = pass == 1 ? linkMap : NULL;
+#endif
+    uint32_t maxUs = 0;
+    uint64_t start = time_us_64();
+    for (uint32_t sector = sectors; sector > 0; sector--) {
+      uint64_t seekStart = time_us_64();
+      if (f_lseek(fil, (sector - 1) * EEPROM_SECTOR_SIZE) != FR_OK) {
+        printf("SD Error! f_lseek failed.\n");
+        break;
+      }
+      uint32_t seekUs = (uint32_t)(time_us_64() - seekStart);
+      maxUs = seekUs > maxUs ? seekUs : maxUs;
+    }
+    uint32_t totalUs = (uint32_t)(time_us_64() - start);
+    printf("  %s: %lu seeks, %lu us average, %lu us worst\n", pass == 1 ? "fast seek" : "FAT chain",
+           sectors, totalUs / sectors, maxUs);
+  }
 }
 
 /* SD Card function wrappers: */
@@ -319,6 +1210,7 @@ bool SD_init() {
 
 /// @brief SD_mount() - wrapper for f_mount
 bool SD_mount(FATFS* fatfs) {
+  SD_setClock(0); // The card might have changed, start again from the safe rate
   FRESULT fr = f_mount(fatfs, "0:", 1);
   sleep_ms(10);
   if (fr != FR_OK) {
@@ -329,6 +1221,7 @@ bool SD_mount(FATFS* fatfs) {
   }
 
   printf("SD Card mount successful.\n");
+  SD_negotiateClock();
   return true;
 }
 
@@ -346,6 +1239,9 @@ bool SD_openFile(FIL *fp, const TCHAR *fileName, BYTE readWrite) {
     return false;
   }
 
+  if ((readWrite & FA_WRITE) == 0) {
+    SD_fastSeek(fp);
+  }
   printf("SD Card openFile successful.\n");
   return true;
 }
@@ -360,6 +1256,7 @@ int SD_writeToFile(FIL *fp, const TCHAR *message) {
 /// @brief SD_closeFile() - wrapper for f_close
 /// @param fp The file pointer to close
 bool SD_closeFile(FIL *fp) {
+  SD_dropFastSeek(fp);
   FRESULT fr = f_close(fp);
   if (fr != FR_OK) {
     printf("SD Error! Could not close file!\n");
@@ -377,6 +1274,58 @@ void SD_unmount() {
   f_unmount("0:");
 }
 
+/// @brief SD_benchmark() measures sequential f_read() throughput of fil at every SD clock that
+///        passes the self-test, then goes back to the negotiated clock.
+/// @param fil The file to read, SD_BENCHMARK_BYTES of it or all of it if it is shorter
+void SD_benchmark(FIL* fil) {
+  uint8_t* reference = blockPoolAcquire();
+  uint8_t* buffer = blockPoolAcquire();
+  uint32_t negotiated = sdClockIndex;
+  if (buffer == NULL) {
+    printf("Error! Not enough free blocks in the pool for the benchmark.\n");
+    blockPoolRelease(reference);
+    return;
+  }
+
+  SD_setClock(0);
+  bool ok = disk_read(0, reference, 0, SD_SELF_TEST_SECTORS) == RES_OK;
+  if (!ok) {
+    printf("SD Error! Could not read the card at %lu Hz.\n", SD_CLOCK_RATES_HZ[0]);
+  }
+  printf("SD read benchmark, %s:\n", ROM_FILE_NAME);
+  for (uint32_t index = 0; index < SD_CLOCK_RATE_COUNT && ok; index++) {
+    uint32_t hz = SD_setClock(index);
+    if (!SD_selfTest(reference, buffer)) {
+      printf("  %8lu Hz: failed the self-test\n", hz);
+      break;
+    }
+
+    uint32_t bytes = 0;
+    UINT bytesRead = BLOCK_POOL_BLOCK_SIZE;
+    uint64_t start = time_us_64();
+    ok = f_lseek(fil, 0) == FR_OK;
+    while (ok && bytes < SD_BENCHMARK_BYTES && bytesRead == BLOCK_POOL_BLOCK_SIZE) {
+      ok = f_read(fil, buffer, BLOCK_POOL_BLOCK_SIZE, &bytesRead) == FR_OK;
+      bytes += bytesRead;
+    }
+    uint32_t elapsedUs = (uint32_t)(time_us_64() - start);
+    if (!ok) {
+      printf("  %8lu Hz: f_read failed\n", hz);
+      break;
+    }
+    uint32_t hundredthsMBps = elapsedUs > 0 ? (uint32_t)((uint64_t)bytes * 100 / elapsedUs) : 0;
+    printf("  %8lu Hz: %lu.%02lu MB/s (%lu bytes in %lu us)\n", hz, hundredthsMBps / 100,
+           hundredthsMBps % 100, bytes, elapsedUs);
+  }
+
+  uint32_t hz = SD_setClock(negotiated);
+  printf("SD clock: back to %lu Hz.\n", hz);
+  printf("SD seek benchmark, %s:\n", ROM_FILE_NAME);
+  SD_benchmarkSeek(fil);
+  blockPoolRelease(reference);
+  blockPoolRelease(buffer);
+}
+
 void handleByteMismatch(uint32_t address, uint8_t expectedData, uint8_t actualData) {
   char message1[32] = "Address: ";
   char message2[32] = "Expected: ";
@@ -393,109 +1342,1100 @@ void handleByteMismatch(uint32_t address, uint8_t expectedData, uint8_t actualDa
   sleep_ms(2000);
 }
 
-/// @brief EEPROM_writeByte(..) writes data byte to address on the EEPROM.
-/// @param address The destination address
-/// @param data The data byte to be written
-void EEPROM_writeByte(uint32_t address, uint8_t data) {
-  write(0x5555, 0xAA);
-  write(0x2AAA, 0x55);
-  write(0x5555, 0xA0);
-  write(address, data);
-}
-
-/// @brief EEPROM_chipErase() performs the 6-byte chip erase sequence.
-void EEPROM_chipErase() {
-  oledDisplayMessages("Erasing", "EEPROM", "now...", "", ""); // Erase happens so fast, you probably won't see this message.
-  setWriteMode();
-  write(0x5555, 0xAA); // 0x5555 0xAA
-  write(0x2AAA, 0x55); // 0x2AAA 0x55
-  write(0x5555, 0x80); // 0x5555 0x80
-  write(0x5555, 0xAA); // 0x5555 0xAA
-  write(0x2AAA, 0x55); // 0x2AAAH 0x55
-  write(0x5555, 0x10); // 0x5555 0x10
-  printf("Chip erase complete!\n");
-  oledDisplayMessages("EEPROM", "erase", "complete!", "Waiting", "1 second.");
-  sleep_ms(1000); // Datasheet says this takes up to 100ms.
+/// @brief recordMismatch() remembers a verify failure for reportMismatches().
+void recordMismatch(uint32_t address, uint8_t expectedData, uint8_t actualData) {
+  if (mismatchCount < MAX_RECORDED_MISMATCHES) {
+    recordedMismatches[mismatchCount].address = address;
+    recordedMismatches[mismatchCount].expected = expectedData;
+    recordedMismatches[mismatchCount].actual = actualData;
+  }
+  mismatchCount += 1;
 }
 
-void EEPROM_WriteCurrentFile(FIL* fil) {
-  oledDisplayMessages("Writing File", "to EEPROM", "now...", "", "");
-  setWriteMode();
-  uint32_t address = 0;
-  FRESULT result;
-  const int BUFFER_SIZE = 1024; // Reads this many bytes from file at a time
-  char buffer[BUFFER_SIZE]; // This is the buffer we will be reading data from disk into
-  UINT numBytesRead = 0; // This is the number of bytes that the f_read function actually read.
+/// @brief reportMismatches() prints the mismatches collected by inline verify, and shows the
+///        first one on the OLED.
+/// @return The total number of mismatches
+uint32_t reportMismatches() {
+  printf("Inline verify: %lu mismatches.\n", mismatchCount);
+  for (uint32_t i = 0; i < mismatchCount && i < MAX_RECORDED_MISMATCHES; i++) {
+    printf("  0x%05lX: expected 0x%02X, actual 0x%02X\n", recordedMismatches[i].address,
+           recordedMismatches[i].expected, recordedMismatches[i].actual);
+  }
 
-  while (true) {
-    result = f_read(fil, buffer, BUFFER_SIZE, &numBytesRead); // First, read N bytes from the file
-    if (result != FR_OK) { break; }
-    for (int i = 0; i < numBytesRead; i++) { // For each byte we read,
-      EEPROM_writeByte(address, buffer[i]); // Write file to EEPROM
-      address += 1;
-    }
+  if (mismatchCount > MAX_RECORDED_MISMATCHES) {
+    printf("  ... and %lu more.\n", mismatchCount - MAX_RECORDED_MISMATCHES);
+  }
 
-    if (numBytesRead < BUFFER_SIZE) { break; } // If we did not read a full buffer worth of info, we're done!
+  if (mismatchCount > 0) {
+    handleByteMismatch(recordedMismatches[0].address, recordedMismatches[0].expected,
+                       recordedMismatches[0].actual);
   }
 
-  char stringTwo[32] = "Addrs: ";
-  sprintf(stringTwo, "%s 0x%05lX", stringTwo, address);
-  oledDisplayMessages("Done writing EEPROM!", "number of", stringTwo, "", "");
-  sleep_ms(5000);
+  return mismatchCount;
 }
 
-void EEPROM_ReadAndVerify(FIL* fil) {
-  oledDisplayMessages("Reading file", "from EEPROM", "now...", "", "");
-  setReadMode();
-  uint32_t address = 0;
-  uint8_t currentByte = 0;
-  int errors = 0;
-  FRESULT result;
-  const int BUFFER_SIZE = 1024; // Reads this many bytes from file at a time
-  char buffer[BUFFER_SIZE]; // This is the buffer we will be reading data from disk into
-  UINT numBytesRead = 0; // This is the number of bytes that the f_read function actually read.
+/// @brief EEPROM_writePage() loads up to a page of bytes with back to back write cycles, and waits
+///        once for the page write cycle with the polling set by completionPollMode. All bytes must
+///        be in the same page. With softwareDataProtection on, the SDP sequence goes first.
+///        With inlineVerify on, the whole page is read back and checked afterwards.
+/// @param address The first address, page aligned unless it is a single byte
+/// @param data The bytes to write
+/// @param length Number of bytes, at most chip->pageSize
+/// @return true if the page write completed, false if it timed out or a byte load came too late
+bool EEPROM_writePage(uint32_t address, const uint8_t* data, uint32_t length) {
+  // Every byte must follow the previous one within tBLC, or the chip starts writing a partial page.
+  // Interrupts stay off for the load so a USB / stdio interrupt can't stretch a gap past it.
+  uint32_t interrupts = save_and_disable_interrupts();
+  if (softwareDataProtection) {
+    writeSequence(SEQUENCE_PROGRAM, BUS_SEQUENCE_LENGTH(SEQUENCE_PROGRAM), address); // Then the page
+  }
+  uint64_t lastLoad = time_us_64();
+  uint32_t longestGapUs = 0;
+  for (uint32_t i = 0; i < length; i++) {
+    write(address + i, data[i]);
+    uint64_t now = time_us_64();
+    longestGapUs = now - lastLoad > longestGapUs ? (uint32_t)(now - lastLoad) : longestGapUs;
+    lastLoad = now;
+  }
+  restore_interrupts(interrupts);
 
-  while (true) {
-    result = f_read(fil, buffer, BUFFER_SIZE, &numBytesRead); // First, read N bytes from the file
-    if (result != FR_OK) { break; }
-    for (int i = 0; i < numBytesRead; i++) { // For each byte we read,
-      currentByte = EEPROM_readByte(address); // Write file to EEPROM
-      // expect buffer[i] == currentByte
-      if (currentByte != buffer[i]) {
-        errors += 1;
-        handleByteMismatch(address, buffer[i], currentByte);
-      }
+  // Checked before polling: the partial page is already being written, no point waiting for it.
+  if (longestGapUs * 1000 >= EEPROM_T_BLC_NS) {
+    printf("Error! Page load at 0x%05lX took %lu us between two bytes, over tBLC.\n", address, longestGapUs);
+    return false;
+  }
 
-      address += 1;
+  if (!EEPROM_waitForCompletion(data[length - 1], chip->byteProgramMaxUs * PROGRAM_TIMEOUT_FACTOR)) {
+    return false;
+  }
+
+  for (uint32_t i = 0; inlineVerify && i < length; i++) {
+    uint8_t actual = EEPROM_readBack(address + i);
+    if (actual != data[i]) {
+      recordMismatch(address + i, data[i], actual);
     }
+  }
 
-    if (numBytesRead < BUFFER_SIZE) { break; } // If we did not read a full buffer worth of info, we're done!
+  return true;
+}
+
+/// @brief EEPROM_pageMatches() checks whether the EEPROM already holds these bytes.
+///        The data pins must be in write mode.
+/// @return true if every byte matches
+bool EEPROM_pageMatches(uint32_t address, const uint8_t* data, uint32_t length) {
+  for (uint32_t i = 0; i < length; i++) {
+    if (EEPROM_readBack(address + i) != data[i]) {
+      return false;
+    }
   }
-  
+  return true;
+}
+
+/// @brief EEPROM_blankPages() is the page write parts' erase: it writes 0xFF over every page in
+///        [address, address + length) that isn't blank already.
+/// @return true if every page write completed
+bool EEPROM_blankPages(uint32_t address, uint32_t length) {
+  static uint8_t blank[MAX_PAGE_SIZE];
+  memset(blank, 0xFF, chip->pageSize);
+  for (uint32_t page = address; page < address + length; page += chip->pageSize) {
+    if (EEPROM_pageMatches(page, blank, chip->pageSize)) { continue; }
+    if (!EEPROM_writePage(page, blank, chip->pageSize)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// @brief EEPROM_disableDataProtection() sends the AT28C software data protection disable
+///        sequence, after which single writes go straight to the array again.
+void EEPROM_disableDataProtection() {
+  setWriteMode();
+  writeSequence(SEQUENCE_SDP_DISABLE, BUS_SEQUENCE_LENGTH(SEQUENCE_SDP_DISABLE), NO_NEXT_ADDRESS);
+  busy_wait_us_32(chip->byteProgramMaxUs); // Takes a write cycle
+}
+
+/// @brief EEPROM_programCommand() issues the byte program bus cycles for a flash part, without
+///        waiting for the program operation: four cycles, or two in unlock bypass mode.
+/// @param address The destination address
+/// @param data The data byte to be written
+void EEPROM_programCommand(uint32_t address, uint8_t data) {
+  if (unlockBypass) {
+    write(address, 0xA0); // XXX 0xA0, at the target address so the second cycle needs no shift
+  } else {
+    writeSequence(SEQUENCE_PROGRAM, BUS_SEQUENCE_LENGTH(SEQUENCE_PROGRAM), address);
+  }
+  write(address, data);
+}
+
+/// @brief EEPROM_programByte(..) writes data byte to address on the EEPROM, and waits for the
+///        byte program operation to finish. The unlock cycles need no wait at all.
+///        With inlineVerify on, the byte read back after completion is checked too.
+///        With pipelinedBus on, nextAddress is shifted in while the chip is busy programming.
+/// @param address The destination address
+/// @param data The data byte to be written
+/// @param nextAddress The first address the caller is going to access next
+/// @return true if the byte program completed, false if it timed out
+bool EEPROM_programByte(uint32_t address, uint8_t data, uint32_t nextAddress) {
+  if (chip->family == CHIP_FAMILY_ATMEL) {
+    return EEPROM_writePage(address, &data, 1); // A page of one
+  }
+
+  EEPROM_programCommand(address, data);
+  if (pipelinedBus) {
+    shiftAddressPreload(nextAddress);
+  }
+
+  if (!EEPROM_waitForCompletion(data, chip->byteProgramMaxUs * PROGRAM_TIMEOUT_FACTOR)) {
+    return false;
+  }
+
+  if (inlineVerify && lastCompletedData != data) {
+    recordMismatch(address, data, lastCompletedData);
+  }
+
+  return true;
+}
+
+/// @brief EEPROM_writeByte(..) writes data byte to address on the EEPROM, see EEPROM_programByte().
+///        Assumes another byte program follows, so the first address of that gets preloaded in
+///        pipelined mode: 0x5555, or the next byte in unlock bypass mode.
+/// @param address The destination address
+/// @param data The data byte to be written
+/// @return true if the byte program completed, false if it timed out
+bool EEPROM_writeByte(uint32_t address, uint8_t data) {
+  return EEPROM_programByte(address, data, unlockBypass ? address + 1 : 0x5555);
+}
+
+/// @brief EEPROM_beginBulkProgram() gets ready for a run of byte programs. AMD parts enter
+///        unlock bypass mode, which halves the bus cycles (and shifts) of every byte after it.
+///        Nothing but byte programs and reads until EEPROM_endBulkProgram(). The data pins must
+///        be in write mode.
+void EEPROM_beginBulkProgram() {
+  if (chip->family != CHIP_FAMILY_AMD || unlockBypass) {
+    return;
+  }
+
+  writeSequence(SEQUENCE_UNLOCK_BYPASS_ENTRY, BUS_SEQUENCE_LENGTH(SEQUENCE_UNLOCK_BYPASS_ENTRY), NO_NEXT_ADDRESS);
+  unlockBypass = true;
+}
+
+/// @brief EEPROM_endBulkProgram() leaves unlock bypass mode, if it was entered.
+void EEPROM_endBulkProgram() {
+  if (!unlockBypass) {
+    return;
+  }
+
+  writeSequence(SEQUENCE_UNLOCK_BYPASS_RESET, BUS_SEQUENCE_LENGTH(SEQUENCE_UNLOCK_BYPASS_RESET), NO_NEXT_ADDRESS);
+  unlockBypass = false;
+}
+
+/// @brief bulkProgramStart() hands every bus pin to the bulk program engine. The data pins must be
+///        in write mode, and any unlock bypass entry written already.
+void bulkProgramStart() {
+  if (busReadRunning) {
+    busReadStop();
+  }
+  if (shiftBackend == SHIFT_BACKEND_PIO) {
+    shiftPioWaitIdle();
+  }
+
+  pio_sm_set_enabled(SHIFT_PIO, shiftPioSm, false);
+  bulk_program_program_init(BULK_PIO, bulkProgramSm, bulkProgramOffset, DATA_PIN_NUMBER, D0_PIN,
+                            CHIP_ENABLE_PIN, shiftClockHz);
+  pio_sm_set_enabled(BULK_PIO, bulkProgramSm, true);
+  addressPreloaded = false;
+  addressLatched = false; // The engine leaves whatever it programmed last on the address lines
+}
+
+/// @brief bulkProgramStop() stops the engine and gives the pins back: /CE, /OE and /WE high,
+///        the data pins still outputs, and the shift register pins to the shift backend.
+void bulkProgramStop() {
+  dma_channel_abort(bulkProgramDma);
+  pio_sm_set_enabled(BULK_PIO, bulkProgramSm, false);
+  pio_sm_clear_fifos(BULK_PIO, bulkProgramSm);
+
+  const int controlPins[] = { CHIP_ENABLE_PIN, OUTPUT_ENABLE_PIN, WRITE_ENABLE_PIN };
+  const int dataPins[] = { D0_PIN, D1_PIN, D2_PIN, D3_PIN, D4_PIN, D5_PIN, D6_PIN, D7_PIN };
+  setControlLines(0);
+  setDataPins(0);
+  for (int i = 0; i < 3; i++) { // Release /OE first, it may have been stopped mid poll
+    gpio_set_function(controlPins[i], GPIO_FUNC_SIO);
+  }
+  busWait(busTiming.outputDisable);
+  for (int i = 0; i < 8; i++) {
+    gpio_set_function(dataPins[i], GPIO_FUNC_SIO);
+  }
+  setShiftBackend(shiftBackend);
+}
+
+/// @brief bulkProgramUsable() is true if the bulk program engine can program the part in the socket.
+bool bulkProgramUsable() {
+  return bulkProgramEngine && chip->family != CHIP_FAMILY_ATMEL && writeSockets == 0x1 && readSocket == 0;
+}
+
+/// @brief bulkProgramWords() builds the engine words for one byte program: the precompiled unlock
+///        cycles (just 0xA0 at the target in unlock bypass mode), then the byte, polled.
+/// @param words Where to put them, room for 4
+/// @return The number of words
+uint32_t bulkProgramWords(uint32_t* words, uint32_t address, uint8_t data) {
+  uint32_t count = 0;
+  if (unlockBypass) {
+    words[count++] = BULK_PROGRAM_WORD(address, 0xA0, 0);
+  } else {
+    for (uint32_t i = 0; i < BUS_SEQUENCE_LENGTH(SEQUENCE_PROGRAM); i++) {
+      words[count++] = SEQUENCE_PROGRAM[i].bulkWord;
+    }
+  }
+  words[count++] = BULK_PROGRAM_WORD(address, data, BULK_PROGRAM_POLL);
+  return count;
+}
+
+/// @brief bulkProgramWait() waits for the engine to finish every word the DMA channel was given.
+///        The engine has no timeout of its own, so this gives up if no word has been taken for
+///        timeoutUs, i.e. a byte program never finished.
+/// @param words The words that were given to the DMA channel
+/// @param count How many
+/// @param timeoutUs How long one byte program may take
+/// @param failedAddress Set to the address of the stuck byte program
+/// @return true once the engine is idle, false if it got stuck
+bool bulkProgramWait(const uint32_t* words, uint32_t count, uint32_t timeoutUs, uint32_t* failedAddress) {
+  uint32_t remaining = count + 1;
+  uint64_t lastProgress = time_us_64();
+  bool drained = false;
+  const uint32_t txStall = 1u << (PIO_FDEBUG_TXSTALL_LSB + bulkProgramSm);
+  while (true) {
+    uint32_t left = dma_channel_hw_addr(bulkProgramDma)->transfer_count +
+                    pio_sm_get_tx_fifo_level(BULK_PIO, bulkProgramSm);
+    if (left == 0 && !drained) { // The last word has been taken, wait for the engine to get back to 'pull'
+      BULK_PIO->fdebug = txStall;
+      drained = true;
+    }
+    if (drained && (BULK_PIO->fdebug & txStall) != 0) {
+      return true;
+    }
+
+    if (left != remaining) {
+      remaining = left;
+      lastProgress = time_us_64();
+    } else if (time_us_64() - lastProgress > timeoutUs) {
+      uint32_t stuck = count - remaining; // Words taken, the last of them is the stuck one
+      *failedAddress = (stuck > 0 ? words[stuck - 1] : words[0]) & (BULK_PROGRAM_POLL - 1);
+      printf("Timed out waiting for program to complete after %lu us.\n", timeoutUs);
+      return false;
+    }
+  }
+}
+
+/// @brief EEPROM_waitForErase() waits for an erase to finish and reports how long it took.
+/// @param what What is being erased, for the serial output ("Chip", "Sector", ...)
+/// @param timeoutUs Give up after this many microseconds.
+/// @return true once the erase has completed, false if it timed out.
+bool EEPROM_waitForErase(const char* what, uint32_t timeoutUs) {
+  uint64_t start = time_us_64();
+  bool done = EEPROM_waitForCompletion(0xFF, timeoutUs); // Erased bytes read back as 0xFF
+  uint32_t elapsedUs = (uint32_t)(time_us_64() - start);
+  if (done) {
+    printf("%s erase complete in %lu.%03lu ms.\n", what, elapsedUs / 1000, elapsedUs % 1000);
+  } else {
+    printf("Error! %s erase did not complete.\n", what);
+  }
+
+  return done;
+}
+
+/// @brief EEPROM_chipEraseCommand() issues the 6-byte chip erase sequence to a flash part, without
+///        waiting for the erase.
+void EEPROM_chipEraseCommand() {
+  EEPROM_endBulkProgram();
+  writeSequence(SEQUENCE_CHIP_ERASE, BUS_SEQUENCE_LENGTH(SEQUENCE_CHIP_ERASE), NO_NEXT_ADDRESS);
+}
+
+/// @brief EEPROM_chipErase() performs the 6-byte chip erase sequence, and waits for it to finish.
+/// @return true if the chip erase completed, false if it timed out.
+bool EEPROM_chipErase() {
+  oledDisplayMessages("Erasing", "EEPROM", "now...", "", ""); // Erase happens so fast, you probably won't see this message.
+  setWriteMode();
+  if (chip->family == CHIP_FAMILY_ATMEL) { // No erase command, write it blank
+    if (!EEPROM_blankPages(0, chip->size)) {
+      oledDisplayMessages("Error!", "Chip erase", "failed.", "", "");
+      handleErr();
+      return false;
+    }
+    oledDisplayMessages("EEPROM", "erase", "complete!", "", "");
+    return true;
+  }
+
+  EEPROM_chipEraseCommand();
+  if (!EEPROM_waitForErase("Chip", chip->chipEraseMaxUs * ERASE_TIMEOUT_FACTOR)) {
+    oledDisplayMessages("Error!", "Chip erase", "timed out.", "", "");
+    handleErr();
+    return false;
+  }
+
+  oledDisplayMessages("EEPROM", "erase", "complete!", "", "");
+  return true;
+}
+
+/// @brief EEPROM_sectorErase() performs the 6-byte sector erase sequence on the sector containing
+///        sectorAddress, and waits for it to finish. That is 4KB on the 39SF0X0, but the AMD
+///        parts have bigger sectors, see chip->sectorSize.
+/// @param sectorAddress Any address inside the sector to erase
+/// @return true if the sector erase completed, false if it timed out.
+bool EEPROM_sectorErase(uint32_t sectorAddress) {
+  if (chip->family == CHIP_FAMILY_ATMEL) { // No erase command, write it blank
+    uint32_t start = sectorAddress - sectorAddress % chip->sectorSize;
+    return EEPROM_blankPages(start, chip->sectorSize);
+  }
+
+  EEPROM_endBulkProgram();
+  writeSequence(SEQUENCE_SECTOR_ERASE, BUS_SEQUENCE_LENGTH(SEQUENCE_SECTOR_ERASE), sectorAddress);
+  write(sectorAddress, 0x30); // SA 0x30, only the sector address bits matter
+  return EEPROM_waitForErase("Sector", chip->sectorEraseMaxUs * ERASE_TIMEOUT_FACTOR);
+}
+
+/// @brief chipSectorCount() is the number of EEPROM_SECTOR_SIZE sectors on the detected part.
+uint32_t chipSectorCount() {
+  return chip->size / EEPROM_SECTOR_SIZE;
+}
+
+/// @brief sectorsPerErase() is how many EEPROM_SECTOR_SIZE sectors one sector erase clears on the
+///        detected part: 1 on the 39SF0X0, more on the AMD parts.
+uint32_t sectorsPerErase() {
+  return chip->sectorSize / EEPROM_SECTOR_SIZE;
+}
+
+/// @brief EEPROM_readSoftwareId() enters Software ID mode, reads the manufacturer and device ID,
+///        and exits Software ID mode again. Leaves the data pins in write mode.
+/// @param manufacturerId Set to the byte at 0x0000
+/// @param deviceId Set to the byte at 0x0001
+void EEPROM_readSoftwareId(uint8_t* manufacturerId, uint8_t* deviceId) {
+  setWriteMode();
+  writeSequence(SEQUENCE_SOFTWARE_ID_ENTRY, BUS_SEQUENCE_LENGTH(SEQUENCE_SOFTWARE_ID_ENTRY), 0x0000);
+  busWait(busTiming.idAccess);
+  *manufacturerId = EEPROM_readBack(0x0000);
+  *deviceId = EEPROM_readBack(0x0001);
+  writeSequence(SEQUENCE_SOFTWARE_ID_EXIT, BUS_SEQUENCE_LENGTH(SEQUENCE_SOFTWARE_ID_EXIT), NO_NEXT_ADDRESS);
+  busWait(busTiming.idAccess);
+}
+
+/// @brief EEPROM_detectChip() identifies the part in the socket, and sizes everything to it.
+///        Anything not in chip_table.h is refused, so it never gets erased or programmed.
+/// @return true if the part is supported
+bool EEPROM_detectChip() {
+  if (manualChip != NULL) {
+    chip = manualChip;
+    useChipTiming();
+    return true;
+  }
+
+  // The ID is read at the worst case timing, the part may have been swapped for a slower one:
+  BusTiming partTiming = busTiming;
+  busTimingInit(&busTiming, busTiming.sysHz, &EEPROM_TIMING_WORST_CASE);
+  uint8_t manufacturerId = 0;
+  uint8_t deviceId = 0;
+  EEPROM_readSoftwareId(&manufacturerId, &deviceId);
+  busTiming = partTiming;
+  chip = chipLookup(manufacturerId, deviceId);
+  useChipTiming();
+  if (chip == NULL) {
+    char idString[32];
+    sprintf(idString, "ID: 0x%02X 0x%02X", manufacturerId, deviceId);
+    printf("Error! Unknown chip, manufacturer ID 0x%02X device ID 0x%02X. Not touching it.\n",
+           manufacturerId, deviceId);
+    printf("Parts without a Software ID (AT28C) have to be selected with 'a' first.\n");
+    oledDisplayMessages("Error! Unknown", "chip in socket.", idString, "", "");
+    handleErr();
+    return false;
+  }
+
+  printf("Detected %s, %lu KB.\n", chip->name, chip->size / 1024);
+  return true;
+}
+
+/// @brief imageFitsChip() checks the image file is no larger than the detected part.
+/// @param fil The image file
+/// @return true if it fits
+bool imageFitsChip(FIL* fil) {
+  if (f_size(fil) <= chip->size) {
+    return true;
+  }
+
+  char nameString[32];
+  sprintf(nameString, "%s", chip->name);
+  printf("Error! %s is %lu bytes, the %s only holds %lu.\n", ROM_FILE_NAME, (uint32_t)f_size(fil),
+         chip->name, chip->size);
+  oledDisplayMessages("Error! Image is", "larger than the", nameString, "", "");
+  handleErr();
+  return false;
+}
+
+/// @brief What has to happen to a byte to turn the current EEPROM contents into the target.
+///        Programming can only clear bits (1 -> 0), setting a bit needs an erase.
+typedef enum {
+  BYTE_MATCHES,
+  BYTE_PROGRAMMABLE,
+  BYTE_NEEDS_ERASE
+} ByteState;
+
+/// @brief classifyByte() works out what it takes to turn current into target.
+/// @param current The byte currently on the EEPROM
+/// @param target The byte we want there
+/// @return ByteState for this byte
+ByteState classifyByte(uint8_t current, uint8_t target) {
+  if (current == target) {
+    return BYTE_MATCHES;
+  }
+
+  return (current & target) == target ? BYTE_PROGRAMMABLE : BYTE_NEEDS_ERASE;
+}
+
+/// @brief The per-sector decision made by the update planner.
+typedef enum {
+  SECTOR_SKIP,
+  SECTOR_PROGRAM,
+  SECTOR_ERASE_PROGRAM
+} SectorAction;
+
+/// @brief UpdatePlan holds the planner's decision for every sector covered by the image.
+typedef struct {
+  uint8_t action[MAX_EEPROM_SECTORS]; // SectorAction for each sector
+  uint32_t sectorCount;               // Number of sectors the image covers
+  uint32_t skipSectors;
+  uint32_t programSectors;
+  uint32_t eraseSectors;
+  uint32_t sectorPlanUs;              // Estimated time to update sector by sector
+  uint32_t chipPlanUs;                // Estimated time to chip erase and program everything
+  bool useChipErase;
+} UpdatePlan;
+
+// Scratch buffers for one sector of the image and of the EEPROM. Too big for the stack.
+static uint8_t imageSector[EEPROM_SECTOR_SIZE] __attribute__((aligned(4)));
+static uint8_t chipSector[EEPROM_SECTOR_SIZE] __attribute__((aligned(4)));
+
+/// @brief readImageSector() reads one sector worth of the image file.
+/// @param fil The image file
+/// @param sector The sector number to read
+/// @return Number of bytes read, 0 at the end of the file or on error.
+UINT readImageSector(FIL* fil, uint32_t sector) {
+  UINT numBytesRead = 0;
+  if (f_lseek(fil, sector * EEPROM_SECTOR_SIZE) != FR_OK) {
+    return 0;
+  }
+
+  if (sdStreamRead(fil, imageSector, EEPROM_SECTOR_SIZE, &numBytesRead, SD_slowDown) != FR_OK) {
+    return 0;
+  }
+
+  return numBytesRead;
+}
+
+/// @brief readChipSector() reads length bytes of a sector from the EEPROM into chipSector.
+///        The data pins must be in read mode.
+/// @param sector The sector number to read
+/// @param length Number of bytes to read
+void readChipSector(uint32_t sector, UINT length) {
+  EEPROM_readBlock(sector * EEPROM_SECTOR_SIZE, chipSector, length);
+}
+
+/// @brief programImageSector() programs every byte of imageSector that differs from
+///        chipSector. The data pins must be in write mode.
+/// @param sector The sector number being programmed
+/// @param length Number of bytes in imageSector
+/// @return true on success, false if a byte program timed out.
+bool programImageSector(uint32_t sector, UINT length) {
+  uint32_t base = sector * EEPROM_SECTOR_SIZE;
+  for (UINT i = 0; i < length; i++) {
+    if (chipSector[i] == imageSector[i]) { continue; }
+    if (!EEPROM_writeByte(base + i, imageSector[i])) {
+      printf("Error! Byte program timed out at address 0x%05lX\n", base + i);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* Core1 bus engine: */
+static bool sectorNeedsErase[MAX_EEPROM_SECTORS]; // Set by BUS_CMD_PROGRAM in bit-compatible mode
+
+/// @brief busSetReadMode() switches the bus direction, if it isn't that way already.
+/// @param readMode true for read mode, false for write mode
+void busSetReadMode(bool readMode) {
+  if (readMode != busInReadMode) {
+    readMode ? setReadMode() : setWriteMode();
+    busInReadMode = readMode;
+  }
+}
+
+/// @brief bulkProgramBlock() programs a block with the bulk program engine: the words for the next
+///        BULK_PROGRAM_CHUNK bytes are built while DMA feeds the previous ones to the engine.
+///        With readFirst, the block is read first (by the read engine) and bytes are skipped or
+///        flagged in sectorNeedsErase like busProgramBuffer() does, without it every byte except
+///        0xFF is programmed. Inline verify reads the whole block back afterwards.
+/// @param command The command, ok and failedAddress are filled in.
+/// @param readFirst PROGRAM_BIT_COMPATIBLE handling
+void bulkProgramBlock(BusCommand* command, bool readFirst) {
+  static uint32_t words[2][BULK_PROGRAM_CHUNK * 4];
+  static uint8_t chipData[SD_STREAM_BLOCK_SIZE] __attribute__((aligned(4)));
+  if (readFirst) {
+    busSetReadMode(true);
+    EEPROM_readBlock(command->address, chipData, command->length);
+  }
+
+  busSetReadMode(false);
+  EEPROM_beginBulkProgram();
+  bulkProgramStart();
+  uint32_t timeoutUs = chip->byteProgramMaxUs * PROGRAM_TIMEOUT_FACTOR;
+  uint32_t buffer = 0;
+  uint32_t inFlight = 0; // Words given to the DMA channel from words[buffer ^ 1]
+  uint32_t next = 0; // The next byte to build words for
+  while (command->ok && (next < command->length || inFlight > 0)) {
+    uint32_t count = 0;
+    for (uint32_t bytes = 0; next < command->length && bytes < BULK_PROGRAM_CHUNK; next++, bytes++) {
+      uint32_t address = command->address + next;
+      uint8_t target = command->data[next];
+      if (readFirst) {
+        uint32_t sector = address / EEPROM_SECTOR_SIZE;
+        if (sectorNeedsErase[sector]) { continue; } // The whole sector gets rewritten later anyway
+
+        ByteState state = classifyByte(chipData[next], target);
+        if (state == BYTE_MATCHES) {
+          busStats.matchedBytes += 1;
+          continue;
+        }
+
+        if (state == BYTE_NEEDS_ERASE) {
+          sectorNeedsErase[sector] = true;
+          continue;
+        }
+      } else if (target == 0xFF) {
+        continue; // Already erased
+      }
+
+      count += bulkProgramWords(words[buffer] + count, address, target);
+      busStats.programmedBytes += 1;
+    }
+
+    if (inFlight > 0 && !bulkProgramWait(words[buffer ^ 1], inFlight, timeoutUs, &command->failedAddress)) {
+      command->ok = false;
+      break;
+    }
+
+    inFlight = count;
+    if (count > 0) {
+      dma_channel_configure(bulkProgramDma, &bulkProgramDmaConfig, &BULK_PIO->txf[bulkProgramSm],
+                            words[buffer], count, true);
+      buffer ^= 1;
+    }
+  }
+
+  bulkProgramStop();
+  EEPROM_endBulkProgram();
+  if (!inlineVerify || !command->ok) {
+    return;
+  }
+
+  busSetReadMode(true);
+  EEPROM_readBlock(command->address, chipData, command->length);
+  for (uint32_t i = 0; i < command->length; i++) {
+    if (readFirst && sectorNeedsErase[(command->address + i) / EEPROM_SECTOR_SIZE]) { continue; }
+    if (chipData[i] != command->data[i]) {
+      recordMismatch(command->address + i, command->data[i], chipData[i]);
+    }
+  }
+}
+
+/// @brief busProgramBuffer() runs a BUS_CMD_PROGRAM on core1.
+///        In PROGRAM_BIT_COMPATIBLE mode bytes are read back first, and sectors that need
+///        a 0 -> 1 change are flagged in sectorNeedsErase instead of being programmed.
+/// @param command The command, ok and failedAddress are filled in.
+void busProgramBuffer(BusCommand* command) {
+  if (bulkProgramUsable()) {
+    bulkProgramBlock(command, programMode == PROGRAM_BIT_COMPATIBLE);
+    return;
+  }
+
+  busSetReadMode(false);
+  EEPROM_beginBulkProgram();
+  uint32_t address = command->address;
+  for (uint32_t i = 0; i < command->length; i++, address++) {
+    uint8_t target = command->data[i];
+    if (programMode == PROGRAM_BIT_COMPATIBLE) {
+      uint32_t sector = address / EEPROM_SECTOR_SIZE;
+      if (sectorNeedsErase[sector]) { continue; } // The whole sector gets rewritten later anyway
+
+      ByteState state = classifyByte(EEPROM_readBack(address), target);
+      if (state == BYTE_MATCHES) {
+        busStats.matchedBytes += 1;
+        continue;
+      }
+
+      if (state == BYTE_NEEDS_ERASE) {
+        sectorNeedsErase[sector] = true;
+        continue;
+      }
+    }
+
+    uint32_t nextAddress = programMode == PROGRAM_BIT_COMPATIBLE || unlockBypass ? address + 1 : 0x5555;
+    if (!EEPROM_programByte(address, target, nextAddress)) {
+      command->ok = false;
+      command->failedAddress = address;
+      break;
+    }
+    busStats.programmedBytes += 1;
+  }
+  EEPROM_endBulkProgram();
+}
+
+/// @brief busProgramPages() runs a BUS_CMD_PROGRAM on core1 for page write parts. Nothing ever
+///        needs an erase, in PROGRAM_BIT_COMPATIBLE mode pages that already match are skipped.
+/// @param command The command, ok and failedAddress are filled in.
+void busProgramPages(BusCommand* command) {
+  busSetReadMode(false);
+  for (uint32_t offset = 0; offset < command->length; offset += chip->pageSize) {
+    uint32_t address = command->address + offset;
+    uint32_t length = command->length - offset < chip->pageSize ? command->length - offset : chip->pageSize;
+    if (programMode == PROGRAM_BIT_COMPATIBLE && EEPROM_pageMatches(address, command->data + offset, length)) {
+      busStats.matchedBytes += length;
+      continue;
+    }
+
+    if (!EEPROM_writePage(address, command->data + offset, length)) {
+      command->ok = false;
+      command->failedAddress = address;
+      return;
+    }
+    busStats.programmedBytes += length;
+  }
+}
+
+/// @brief busVerifyBuffer() runs a BUS_CMD_VERIFY on core1, recording any mismatches.
+/// @param command The command, ok is cleared if anything mismatched.
+void busVerifyBuffer(BusCommand* command) {
+  static uint8_t chipData[SD_STREAM_BLOCK_SIZE] __attribute__((aligned(4)));
+  busSetReadMode(true);
+  EEPROM_readBlock(command->address, chipData, command->length);
+  for (uint32_t i = 0; i < command->length; i++) {
+    if (chipData[i] != command->data[i]) {
+      recordMismatch(command->address + i, command->data[i], chipData[i]);
+      command->ok = false;
+    }
+  }
+  busStats.verifiedBytes += command->length;
+}
+
+/// @brief busEraseSector() runs a BUS_CMD_ERASE_SECTOR on core1.
+/// @param command The command, ok and failedAddress are filled in.
+void busEraseSector(BusCommand* command) {
+  busSetReadMode(false);
+  if (!EEPROM_sectorErase(command->address)) {
+    command->ok = false;
+    command->failedAddress = command->address;
+  }
+}
+
+/// @brief busProgramErased() runs a BUS_CMD_PROGRAM_ERASED on core1. No read back needed,
+///        0xFF bytes are skipped since they are already erased.
+/// @param command The command, ok and failedAddress are filled in.
+void busProgramErased(BusCommand* command) {
+  if (bulkProgramUsable()) {
+    bulkProgramBlock(command, false);
+    return;
+  }
+
+  busSetReadMode(false);
+  EEPROM_beginBulkProgram();
+  for (uint32_t i = 0; i < command->length; i++) {
+    if (command->data[i] == 0xFF) { continue; } // Already erased
+    if (!EEPROM_writeByte(command->address + i, command->data[i])) {
+      command->ok = false;
+      command->failedAddress = command->address + i;
+      break;
+    }
+    busStats.programmedBytes += 1;
+  }
+  EEPROM_endBulkProgram();
+}
+
+/* Gang programming: */
+uint32_t gangSockets = 0; // Sockets still in the gang job, any that fail are dropped from it
+uint32_t socketFailedAddress[MAX_SOCKETS];
+uint32_t socketMismatches[MAX_SOCKETS];
+uint32_t socketFirstMismatch[MAX_SOCKETS];
+
+/// @brief firstSocket() is the lowest numbered socket in sockets, or 0 if there are none.
+uint32_t firstSocket(uint32_t sockets) {
+  for (uint32_t i = 0; i < MAX_SOCKETS; i++) {
+    if (sockets & (1u << i)) { return i; }
+  }
+  return 0;
+}
+
+/// @brief gangWaitForCompletion() waits for a program or erase issued to every socket in
+///        gangSockets, polling each chip in turn. By the time the first one is done the others
+///        usually are too, so the extra sockets cost a status read each. Sockets that time out
+///        are dropped from the gang, with inline verify each byte is checked per socket.
+/// @param address The address that was programmed, for the report
+/// @param expected The byte that was programmed (0xFF for an erase)
+/// @param timeoutUs Give up on a socket after this many microseconds
+/// @return false once no sockets are left
+bool gangWaitForCompletion(uint32_t address, uint8_t expected, uint32_t timeoutUs) {
+  for (uint32_t socket = 0; socket < MAX_SOCKETS; socket++) {
+    if ((gangSockets & (1u << socket)) == 0) { continue; }
+
+    selectSockets(1u << socket, socket); // A DQ5 reset only goes to the chip that needs it
+    if (!EEPROM_waitForCompletion(expected, timeoutUs)) {
+      printf("Socket %lu failed at 0x%05lX, dropped from the gang.\n", socket, address);
+      gangSockets &= ~(1u << socket);
+      socketFailedAddress[socket] = address;
+    } else if (inlineVerify && lastCompletedData != expected) {
+      socketFirstMismatch[socket] = socketMismatches[socket] == 0 ? address : socketFirstMismatch[socket];
+      socketMismatches[socket] += 1;
+    }
+  }
+
+  selectSockets(gangSockets, firstSocket(gangSockets));
+  return gangSockets != 0;
+}
+
+/// @brief busGangProgram() runs a BUS_CMD_GANG_PROGRAM on core1: every byte is programmed into
+///        all the sockets in gangSockets at once. The chips must be erased, 0xFF bytes are skipped.
+/// @param command The command, ok is cleared once every socket has failed.
+void busGangProgram(BusCommand* command) {
+  busSetReadMode(false);
+  EEPROM_beginBulkProgram();
+  for (uint32_t i = 0; i < command->length; i++) {
+    if (command->data[i] == 0xFF) { continue; } // Already erased
+    EEPROM_programCommand(command->address + i, command->data[i]);
+    if (!gangWaitForCompletion(command->address + i, command->data[i],
+                               chip->byteProgramMaxUs * PROGRAM_TIMEOUT_FACTOR)) {
+      command->ok = false;
+      command->failedAddress = command->address + i;
+      break;
+    }
+    busStats.programmedBytes += 1;
+  }
+  EEPROM_endBulkProgram();
+}
+
+/// @brief Where one socket is up to in a BUS_CMD_INTERLEAVED_PROGRAM.
+typedef struct {
+  uint32_t index;   // The byte of the block being programmed, or next to program
+  bool busy;        // A byte program is in progress
+  uint64_t startUs; // When it was issued
+} SocketProgress;
+
+/// @brief busInterleavedProgram() runs a BUS_CMD_INTERLEAVED_PROGRAM on core1: every socket in
+///        command->sockets gets its own data, from socketData. The sockets are
+///        visited round robin; a busy socket gets one status check, a finished one gets its next
+///        byte program issued, so the bus keeps working on the other sockets while each chip is
+///        programming instead of waiting on it. The chips must be erased, 0xFF bytes are skipped.
+///        gangSockets belongs to core0, the sockets that fail go back in failedSockets instead.
+/// @param command The command, ok is cleared once every socket has failed.
+void busInterleavedProgram(BusCommand* command) {
+  SocketProgress progress[MAX_SOCKETS] = { 0 };
+  uint32_t timeoutUs = chip->byteProgramMaxUs * PROGRAM_TIMEOUT_FACTOR;
+  busSetReadMode(false);
+  selectSockets(command->sockets, firstSocket(command->sockets));
+  EEPROM_beginBulkProgram();
+
+  command->failedSockets = 0;
+  uint32_t active = command->sockets;
+  while (active != 0) {
+    for (uint32_t socket = 0; socket < MAX_SOCKETS; socket++) {
+      if ((active & (1u << socket)) == 0) { continue; }
+
+      const uint8_t* data = command->socketData[socket];
+      SocketProgress* p = &progress[socket];
+      uint32_t address = command->address + p->index;
+      selectSockets(1u << socket, socket);
+      if (p->busy) {
+        PollResult poll = pollCompletion(address, data[p->index]);
+        bool timedOut = poll == POLL_BUSY && time_us_64() - p->startUs > timeoutUs;
+        if (poll == POLL_BUSY && !timedOut) { continue; } // Come back once the others had a turn
+
+        p->busy = false;
+        if (poll != POLL_DONE) {
+          printf("Socket %lu failed at 0x%05lX, dropped.\n", socket, address);
+          command->failedSockets |= 1u << socket;
+          active &= ~(1u << socket);
+          socketFailedAddress[socket] = address;
+          continue;
+        }
+
+        if (inlineVerify && lastCompletedData != data[p->index]) {
+          socketFirstMismatch[socket] = socketMismatches[socket] == 0 ? address : socketFirstMismatch[socket];
+          socketMismatches[socket] += 1;
+        }
+        busStats.programmedBytes += 1;
+        p->index += 1;
+      }
+
+      while (p->index < command->length && data[p->index] == 0xFF) { // Already erased
+        p->index += 1;
+      }
+      if (p->index == command->length) {
+        active &= ~(1u << socket);
+        continue;
+      }
+
+      EEPROM_programCommand(command->address + p->index, data[p->index]);
+      p->busy = true;
+      p->startUs = time_us_64();
+    }
+  }
+
+  uint32_t remaining = command->sockets & ~command->failedSockets;
+  selectSockets(remaining, firstSocket(remaining));
+  EEPROM_endBulkProgram();
+  if (remaining == 0) {
+    command->ok = false;
+    command->failedAddress = command->address;
+  }
+}
+
+/// @brief busEngineMain() is the core1 entrypoint. It runs bus commands from core0 in order
+///        and sends each one back as its result, which also hands the data buffer back.
+void busEngineMain() {
+  multicore_lockout_victim_init(); // Lets core0 pause us while it writes the calibration to flash
+  while (true) {
+    BusCommand command;
+    while (!busQueuePop(&busCommands, &command)) {
+      __wfe();
+    }
+
+    command.ok = true;
+    uint64_t start = time_us_64();
+    if (command.type == BUS_CMD_PROGRAM && chip->pageSize > 0) {
+      busProgramPages(&command);
+    } else if (command.type == BUS_CMD_PROGRAM) {
+      busProgramBuffer(&command);
+    } else if (command.type == BUS_CMD_VERIFY) {
+      busVerifyBuffer(&command);
+    } else if (command.type == BUS_CMD_ERASE_SECTOR) {
+      busEraseSector(&command);
+    } else if (command.type == BUS_CMD_PROGRAM_ERASED) {
+      busProgramErased(&command);
+    } else if (command.type == BUS_CMD_GANG_PROGRAM) {
+      busGangProgram(&command);
+    } else if (command.type == BUS_CMD_INTERLEAVED_PROGRAM) {
+      busInterleavedProgram(&command);
+    }
+    busStats.busyUs += time_us_64() - start;
+
+    while (!busQueuePush(&busResults, &command)) {
+      __wfe();
+    }
+    __sev();
+  }
+}
+
+/// @brief busSubmit() queues a command for the bus engine on core1.
+void busSubmit(const BusCommand* command) {
+  while (!busQueuePush(&busCommands, command)) {
+    __wfe();
+  }
+  __sev();
+}
+
+/// @brief busWaitResult() waits for the next result from the bus engine.
+void busWaitResult(BusCommand* result) {
+  while (!busQueuePop(&busResults, result)) {
+    __wfe();
+  }
+  __sev(); // There may be a slot free for core1 to push into again
+}
+
+/// @brief busCollectResult() handles one result from the bus engine: its block goes back to
+///        the stream, and the first failure is kept in firstFailure.
+void busCollectResult(const BusCommand* done, BusCommand* firstFailure) {
+  sdStreamRelease(&imageStream);
+  if (!done->ok && firstFailure->ok) {
+    *firstFailure = *done;
+  }
+}
+
+/// @brief busStreamFile() streams the file through the bus engine from address 0. Core0 keeps
+///        prefetching the next 4KB blocks from the SD card while core1 works on earlier ones.
+/// @param fil The file to stream
+/// @param type BUS_CMD_PROGRAM, BUS_CMD_GANG_PROGRAM or BUS_CMD_VERIFY
+/// @param result Filled in with the first failed result, if there is one.
+/// @return Number of bytes streamed
+uint32_t busStreamFile(FIL* fil, BusCommandType type, BusCommand* result) {
+  uint32_t address = 0;
+  uint32_t inFlight = 0;
+  result->ok = true;
+  if (!sdStreamOpen(&imageStream, fil, time_us_64, SD_slowDown)) {
+    printf("Error! Not enough free blocks in the pool for the SD stream.\n");
+    result->ok = false;
+    return 0;
+  }
+
+  while (true) {
+    BusCommand done;
+    while (busQueuePop(&busResults, &done)) { // Take back whatever core1 has finished with
+      busCollectResult(&done, result);
+      inFlight -= 1;
+    }
+
+    bool stop = type != BUS_CMD_VERIFY && !result->ok; // Keep going on verify to count every mismatch
+    SDStreamBlock* block = stop ? NULL : sdStreamNext(&imageStream);
+    if (block != NULL) {
+      BusCommand command = { .type = type, .address = block->offset, .data = block->data,
+                             .length = block->length, .tag = sdStreamIndexOf(&imageStream, block) };
+      busSubmit(&command);
+      inFlight += 1;
+      address = block->offset + block->length;
+      continue;
+    }
+
+    if (inFlight == 0) { break; } // End of the file (or an error), and everything is back
+    if (stop || !sdStreamPrefetch(&imageStream)) { // Nothing to read ahead, wait for core1 instead
+      busWaitResult(&done);
+      busCollectResult(&done, result);
+      inFlight -= 1;
+    }
+  }
+
+  if (imageStream.error != FR_OK) {
+    printf("SD Error! f_read failed with %d.\n", imageStream.error);
+  }
+  sdStreamPrintStats(&imageStream);
+  sdStreamClose(&imageStream);
+  return address;
+}
+
+/// @brief printCycleTime() prints the average bus time per byte for a job.
+/// @param what What the bytes were, e.g. "programmed"
+/// @param bytes How many bytes the job touched
+/// @param busyUs How long it kept the bus busy
+void printCycleTime(const char* what, uint32_t bytes, uint64_t busyUs) {
+  if (bytes == 0) { return; }
+  printf("%lu bytes %s in %lu us, %lu ns per byte (%s bus).\n", bytes, what, (uint32_t)busyUs,
+         (uint32_t)(busyUs * 1000 / bytes), pipelinedBus ? "pipelined" : "sequential");
+}
+
+/// @brief EEPROM_WriteCurrentFile() programs the file into the EEPROM starting at address 0.
+///        In PROGRAM_BIT_COMPATIBLE mode no prior erase is needed, sectors that can't be
+///        programmed in place are erased and reprogrammed once the rest of the file is done.
+///        The bus work happens on core1 while core0 keeps reading the file.
+/// @param fil The file to write
+void EEPROM_WriteCurrentFile(FIL* fil) {
+  if (!imageFitsChip(fil)) {
+    return;
+  }
+
+  oledDisplayMessages("Writing File", "to EEPROM", "now...", "", "");
+  uint32_t erasedSectors = 0;
+  memset(sectorNeedsErase, 0, sizeof(sectorNeedsErase));
+  memset(&busStats, 0, sizeof(busStats));
+  mismatchCount = 0;
+
+  BusCommand result;
+  uint32_t address = busStreamFile(fil, BUS_CMD_PROGRAM, &result);
+
+  // Now erase and rewrite any sectors that needed a bit set from 0 back to 1. Where the chip erases
+  // more than one of our sectors at once, all of them get rewritten from the image:
+  for (uint32_t first = 0; first < chipSectorCount() && result.ok; first += sectorsPerErase()) {
+    bool needsErase = false;
+    for (uint32_t sector = first; sector < first + sectorsPerErase(); sector++) {
+      needsErase |= sectorNeedsErase[sector];
+    }
+    if (!needsErase) { continue; }
+
+    BusCommand erase = { .type = BUS_CMD_ERASE_SECTOR, .address = first * EEPROM_SECTOR_SIZE };
+    busSubmit(&erase);
+    busWaitResult(&result);
+    erasedSectors += 1;
+    for (uint32_t sector = first; sector < first + sectorsPerErase() && result.ok; sector++) {
+      BusCommand command = { .type = BUS_CMD_PROGRAM_ERASED, .address = sector * EEPROM_SECTOR_SIZE,
+                             .data = imageSector, .length = readImageSector(fil, sector) };
+      if (command.length == 0) { break; } // Past the end of the image
+      busSubmit(&command);
+      busWaitResult(&result);
+    }
+  }
+
+  if (!result.ok) {
+    char addressString[32];
+    sprintf(addressString, "Addr: 0x%05lX", result.failedAddress);
+    printf("Error! Programming failed at address 0x%05lX\n", result.failedAddress);
+    oledDisplayMessages("Error! Byte program", "failed.", addressString, "", "");
+    handleErr();
+    return;
+  }
+
+  printf("Wrote 0x%05lX bytes: %lu already matched, %lu programmed, %lu sectors erased.\n",
+         address, busStats.matchedBytes, busStats.programmedBytes, erasedSectors);
+  printCycleTime("programmed or checked", busStats.matchedBytes + busStats.programmedBytes, busStats.busyUs);
+  if (inlineVerify && reportMismatches() > 0) {
+    return;
+  }
+
+  char stringTwo[32] = "Addrs: ";
+  sprintf(stringTwo, "%s 0x%05lX", stringTwo, address);
+  oledDisplayMessages("Done writing EEPROM!", "number of", stringTwo, "", "");
+  sleep_ms(5000);
+}
+
+/// @brief EEPROM_ReadAndVerify() compares the EEPROM against the file, on core1 while
+///        core0 keeps reading the file.
+/// @param fil The file to compare against
+void EEPROM_ReadAndVerify(FIL* fil) {
+  if (!imageFitsChip(fil)) {
+    return;
+  }
+
+  oledDisplayMessages("Reading file", "from EEPROM", "now...", "", "");
+  memset(&busStats, 0, sizeof(busStats));
+  mismatchCount = 0;
+
+  BusCommand result;
+  uint32_t address = busStreamFile(fil, BUS_CMD_VERIFY, &result);
+  uint32_t errors = mismatchCount > 0 ? reportMismatches() : 0;
+  printCycleTime("verified", busStats.verifiedBytes, busStats.busyUs);
+
   char stringTwo[32] = "Addrs: ";
   char stringThree[32] = "Num errors: ";
   sprintf(stringTwo, "%s 0x%05lX", stringTwo, address);
-  sprintf(stringThree, "%s %d", stringThree, errors);
+  sprintf(stringThree, "%s %lu", stringThree, errors);
   oledDisplayMessages("Done reading EEPROM!", stringTwo, stringThree, "", "");
 }
 
+/// @brief EEPROM_VerifyErased() checks every byte on the chip reads back as 0xFF. One sector is
+///        checked while the read engine fetches the next one.
 void EEPROM_VerifyErased() {
+  static uint8_t readRing[2][EEPROM_SECTOR_SIZE] __attribute__((aligned(4)));
   oledDisplayMessages("Verifying", "EEPROM is", "erased now...", "", "");
   setReadMode();
   uint32_t address = 0;
-  uint8_t currentByte = 0;
   int errors = 0;
+  uint64_t start = time_us_64();
+  mismatchCount = 0;
+
+  EEPROM_readBlockStart(0, readRing[0], EEPROM_SECTOR_SIZE);
+  for (uint32_t sector = 0; sector < chipSectorCount(); sector++) { // For each sector on the chip,
+    EEPROM_readBlockWait();
+    uint8_t* current = readRing[sector % 2];
+    if (sector + 1 < chipSectorCount()) { // Start on the next one before checking this one
+      EEPROM_readBlockStart((sector + 1) * EEPROM_SECTOR_SIZE, readRing[(sector + 1) % 2], EEPROM_SECTOR_SIZE);
+    }
 
-  for (int i = 0; i < MAX_EEPROM_ADDRESS_SPACE; i++) { // For each byte on the chip,
-    currentByte = EEPROM_readByte(address); // Read that byte
-    if (currentByte != 0xFF) { // EEPROM erases all bytes to 0xFF
-      errors += 1;
-      handleByteMismatch(address, 0xFF, currentByte);
+    for (uint32_t i = 0; i < EEPROM_SECTOR_SIZE; i++, address++) {
+      if (current[i] != 0xFF) { // EEPROM erases all bytes to 0xFF
+        errors += 1;
+        recordMismatch(address, 0xFF, current[i]);
+      }
     }
+  }
+  busReadStop();
 
-    address += 1;
+  uint32_t elapsedMs = (uint32_t)((time_us_64() - start) / 1000);
+  printf("Blank check of 0x%05lX bytes took %lu ms.\n", address, elapsedMs);
+  if (errors > 0) {
+    reportMismatches();
   }
-  
+
   char stringTwo[32] = "Addrs: ";
   char stringThree[32] = "Num errors: ";
   sprintf(stringTwo, "%s 0x%05lX", stringTwo, address);
@@ -503,6 +2443,687 @@ void EEPROM_VerifyErased() {
   oledDisplayMessages("Done reading EEPROM!", stringTwo, stringThree, "", "");
 }
 
+/// @brief EEPROM_DumpToFile() reads the whole chip out to a new file. The file is allocated in one
+///        contiguous run up front with f_expand(), so each 4KB block goes to the card as a single
+///        multi-sector write with no cluster allocation in between, and the read engine fetches the
+///        next block into the other pool block while the current one is being written.
+/// @param fil A file just created for writing
+void EEPROM_DumpToFile(FIL* fil) {
+  uint8_t* blocks[2] = { blockPoolAcquire(), blockPoolAcquire() };
+  if (blocks[1] == NULL) {
+    printf("Error! Not enough free blocks in the pool for the dump.\n");
+    blockPoolRelease(blocks[0]);
+    return;
+  }
+
+#if FF_USE_EXPAND
+  FRESULT fr = f_expand(fil, chip->size, 1);
+  if (fr != FR_OK) { // Still works, FatFs just allocates clusters as it goes
+    printf("SD: could not allocate %lu contiguous bytes (%d), writing it unallocated.\n", chip->size, fr);
+  }
+#endif
+
+  oledDisplayMessages("Dumping", "EEPROM to", "SD card...", "", "");
+  printf("Dumping %s to %s.\n", chip->name, DUMP_FILE_NAME);
+  setReadMode();
+  uint32_t address = 0;
+  uint64_t writeUs = 0;
+  uint64_t start = time_us_64();
+  bool ok = true;
+
+  EEPROM_readBlockStart(0, blocks[0], BLOCK_POOL_BLOCK_SIZE);
+  for (uint32_t block = 0; ok && address < chip->size; block++) {
+    EEPROM_readBlockWait();
+    uint8_t* current = blocks[block % 2];
+    if (address + BLOCK_POOL_BLOCK_SIZE < chip->size) { // Start on the next one before writing this one
+      EEPROM_readBlockStart(address + BLOCK_POOL_BLOCK_SIZE, blocks[(block + 1) % 2], BLOCK_POOL_BLOCK_SIZE);
+    }
+
+    UINT bytesWritten = 0;
+    uint64_t writeStart = time_us_64();
+    ok = f_write(fil, current, BLOCK_POOL_BLOCK_SIZE, &bytesWritten) == FR_OK && bytesWritten == BLOCK_POOL_BLOCK_SIZE;
+    writeUs += time_us_64() - writeStart;
+    address += ok ? BLOCK_POOL_BLOCK_SIZE : 0;
+  }
+  EEPROM_readBlockWait(); // Nothing may still be landing in a block once it is back in the pool
+  busReadStop();
+  ok = f_sync(fil) == FR_OK && ok;
+  uint32_t elapsedUs = (uint32_t)(time_us_64() - start);
+  blockPoolRelease(blocks[0]);
+  blockPoolRelease(blocks[1]);
+
+  if (!ok) {
+    f_truncate(fil); // Don't leave the rest of the allocation looking like part of the dump
+    printf("SD Error! Writing %s failed at 0x%05lX.\n", DUMP_FILE_NAME, address);
+    oledDisplayMessages("SD Error!", "Could not", "write dump.", "", "");
+    handleErr();
+    return;
+  }
+
+  uint32_t writeMs = (uint32_t)(writeUs / 1000);
+  printf("Dumped 0x%05lX bytes in %lu ms, %lu KB/s (%lu ms of it writing to the SD card).\n", address,
+         elapsedUs / 1000, elapsedUs > 0 ? (uint32_t)((uint64_t)address * 1000 / elapsedUs) : 0, writeMs);
+  char stringTwo[32] = "Addrs: ";
+  sprintf(stringTwo, "%s 0x%05lX", stringTwo, address);
+  oledDisplayMessages("Done dumping EEPROM!", stringTwo, "", "", "");
+}
+
+/// @brief EEPROM_benchmarkBus() measures the per-byte cycle time of sequential reads and byte
+///        programs, with and without the pipelined bus. Reads don't touch the contents. Programs
+///        go to the last sector, which gets erased before each run and after the benchmark.
+void EEPROM_benchmarkBus() {
+  const uint32_t scratch = chip->size - chip->sectorSize; // The last sector the chip can erase on its own
+  bool wasPipelined = pipelinedBus;
+  mismatchCount = 0;
+  oledDisplayMessages("Benchmarking", "bus cycle time", "now...", "", "");
+  printf("Bus benchmark (%s shift backend, %s bus HAL), scratch sector at 0x%05lX:\n",
+         shiftBackend == SHIFT_BACKEND_PIO ? "PIO" : "bit-bang",
+         busHal == BUS_HAL_SIO ? "SIO" : "per-pin", scratch);
+
+  // The bus HAL on its own: /WE without /CE is ignored by the chip, so this never writes.
+  setWriteMode();
+  BusHal previousHal = busHal;
+  volatile uint8_t sink = 0;
+  for (int hal = 0; hal < 2; hal++) {
+    busHal = hal == 0 ? BUS_HAL_PER_PIN : BUS_HAL_SIO;
+    uint64_t start = time_us_64();
+    for (uint32_t i = 0; i < EEPROM_SECTOR_SIZE; i++) {
+      setDataPins((uint8_t)i);
+      setControlLines(BUS_WE);
+      setControlLines(0);
+      sink += readDataPins();
+    }
+    uint64_t halUs = time_us_64() - start;
+    printf("  %-10s HAL:     %lu ns per data put + /WE pulse + data get\n",
+           busHal == BUS_HAL_SIO ? "SIO" : "per-pin", (uint32_t)(halUs * 1000 / EEPROM_SECTOR_SIZE));
+  }
+  busHal = previousHal;
+
+  for (int run = 0; run < 2; run++) {
+    pipelinedBus = run == 1;
+    const char* mode = pipelinedBus ? "pipelined" : "sequential";
+
+    setReadMode();
+    uint64_t start = time_us_64();
+    EEPROM_readBlock(0, chipSector, EEPROM_SECTOR_SIZE);
+    uint64_t readUs = time_us_64() - start;
+    printf("  %-10s read:    %lu ns per byte\n", mode, (uint32_t)(readUs * 1000 / EEPROM_SECTOR_SIZE));
+
+    setWriteMode();
+    if (!EEPROM_sectorErase(scratch)) { break; }
+    start = time_us_64();
+    EEPROM_beginBulkProgram();
+    uint32_t address = scratch;
+    for (; address < scratch + EEPROM_SECTOR_SIZE; address++) {
+      if (!EEPROM_writeByte(address, (uint8_t)address ^ 0x5A)) { break; }
+    }
+    EEPROM_endBulkProgram();
+    uint64_t programUs = time_us_64() - start;
+    printf("  %-10s program: %lu ns per byte\n", mode, (uint32_t)(programUs * 1000 / EEPROM_SECTOR_SIZE));
+  }
+
+  if (bulkProgramUsable() && EEPROM_sectorErase(scratch)) { // The same pattern through the bulk program engine
+    for (uint32_t i = 0; i < EEPROM_SECTOR_SIZE; i++) {
+      chipSector[i] = (uint8_t)(scratch + i) ^ 0x5A;
+    }
+    BusCommand command = { .type = BUS_CMD_PROGRAM_ERASED, .address = scratch, .data = chipSector,
+                           .length = EEPROM_SECTOR_SIZE, .ok = true };
+    bool wasVerifying = inlineVerify;
+    inlineVerify = false;
+    uint64_t start = time_us_64();
+    bulkProgramBlock(&command, false);
+    uint64_t programUs = time_us_64() - start;
+    inlineVerify = wasVerifying;
+    printf("  %-10s program: %lu ns per byte (tBP is %lu us)\n", "bulk", (uint32_t)(programUs * 1000 / EEPROM_SECTOR_SIZE),
+           chip->byteProgramTypicalUs);
+  }
+
+  if (shiftBackend == SHIFT_BACKEND_PIO) {
+    printf("  (the PIO read engine is always pipelined, only programs differ)\n");
+  }
+  setWriteMode();
+  EEPROM_sectorErase(scratch);
+  pipelinedBus = wasPipelined;
+  oledDisplayMessages("Done benchmarking", "see serial port", "", "", "");
+}
+
+/// @brief calibrationPattern() is the byte the calibration expects at address. Neighbouring
+///        addresses always differ, so a wrong address bit shows up as a mismatch.
+uint8_t calibrationPattern(uint32_t address) {
+  return (uint8_t)(address ^ (address >> 8) ^ 0xA5);
+}
+
+/// @brief calibrationProgram() erases the sector at scratch and programs the pattern into its
+///        first length bytes, using whatever timing is currently set.
+/// @return true if every byte program completed
+bool calibrationProgram(uint32_t scratch, uint32_t length) {
+  setWriteMode();
+  if (!EEPROM_sectorErase(scratch)) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < length; i++) {
+    if (!EEPROM_writeByte(scratch + i, calibrationPattern(scratch + i))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// @brief calibrationCheck() reads back the first length bytes of scratch CALIBRATION_PASSES
+///        times, one byte at a time or through the read engine.
+/// @return true if the pattern read back correctly every time
+bool calibrationCheck(uint32_t scratch, uint32_t length, bool blockRead) {
+  setReadMode();
+  for (int pass = 0; pass < CALIBRATION_PASSES; pass++) {
+    if (blockRead) {
+      EEPROM_readBlock(scratch, chipSector, length);
+    } else {
+      for (uint32_t i = 0; i < length; i++) {
+        chipSector[i] = EEPROM_readByte(scratch + i);
+      }
+    }
+
+    for (uint32_t i = 0; i < length; i++) {
+      if (chipSector[i] != calibrationPattern(scratch + i)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/// @brief cyclesToNs() converts a cycle count at the current clk_sys to ns, rounding up.
+uint32_t cyclesToNs(uint32_t cycles) {
+  return (uint32_t)(((uint64_t)cycles * 1000000000u + busTiming.sysHz - 1) / busTiming.sysHz);
+}
+
+/// @brief withCalibrationMargin() backs a measured time off by calibrationMarginPercent of itself,
+///        or by calibrationMinMarginPercent of the datasheet value, whichever is more. Never more
+///        than the datasheet value though, that is always allowed.
+/// @param measuredNs The shortest time that passed
+/// @param datasheetNs The datasheet time it replaces
+uint32_t withCalibrationMargin(uint32_t measuredNs, uint32_t datasheetNs) {
+  uint32_t scaled = measuredNs * (100 + calibrationMarginPercent) / 100;
+  uint32_t padded = measuredNs + datasheetNs * calibrationMinMarginPercent / 100;
+  uint32_t ns = scaled > padded ? scaled : padded;
+  return ns > datasheetNs ? datasheetNs : ns;
+}
+
+/// @brief EEPROM_calibrateBus() sweeps the /WE pulse width, the shift clock and the read access
+///        delay downwards (one at a time, the others at the datasheet values) against the last
+///        sector, keeps the fastest setting that still passes, backs off by calibrationMarginPercent
+///        and stores the result in flash for setup() to load. The last sector is erased afterwards.
+void EEPROM_calibrateBus() {
+  const uint32_t scratch = chip->size - chip->sectorSize; // The last sector the chip can erase on its own
+  bool wasInlineVerify = inlineVerify;
+  inlineVerify = false; // The sweeps check the data themselves
+  oledDisplayMessages("Calibrating", "bus timing", "now...", "", "");
+
+  BusCalibration calibration;
+  datasheetCalibration(&calibration);
+  applyBusCalibration(&calibration);
+  BusTiming datasheet = busTiming;
+  if (!calibrationProgram(scratch, EEPROM_SECTOR_SIZE) || !calibrationCheck(scratch, EEPROM_SECTOR_SIZE, false)) {
+    printf("Calibration failed at the datasheet timing, check the chip and the board.\n");
+    oledDisplayMessages("Error! Calibration", "failed at datasheet", "timing.", "", "");
+    inlineVerify = wasInlineVerify;
+    handleErr();
+    return;
+  }
+
+  // /WE pulse width: erase and verify with the datasheet width, program with the one under test.
+  uint32_t writePulse = datasheet.writePulse;
+  for (uint32_t cycles = datasheet.writePulse; cycles > 0; cycles--) {
+    busTiming.writePulse = datasheet.writePulse;
+    setWriteMode();
+    if (!EEPROM_sectorErase(scratch)) { break; }
+    busTiming.writePulse = cycles;
+    bool programmed = true;
+    for (uint32_t i = 0; i < CALIBRATION_PROGRAM_BYTES && programmed; i++) {
+      programmed = EEPROM_writeByte(scratch + i, calibrationPattern(scratch + i));
+    }
+    busTiming.writePulse = datasheet.writePulse;
+    if (!programmed || !calibrationCheck(scratch, CALIBRATION_PROGRAM_BYTES, false)) { break; }
+    writePulse = cycles;
+  }
+  printf("  /WE pulse: %lu cycles pass (datasheet %lu)\n", writePulse, datasheet.writePulse);
+
+  // The rest only read, so put the whole pattern back first:
+  if (!calibrationProgram(scratch, EEPROM_SECTOR_SIZE)) {
+    printf("Calibration failed reprogramming the scratch sector.\n");
+    inlineVerify = wasInlineVerify;
+    handleErr();
+    return;
+  }
+
+  // Shift clock, through both the shift program and the read engine. Only the PIO backend has one.
+  uint32_t shiftHz = SHIFT_REGISTER_CLOCK_HZ;
+  uint32_t maxShiftHz = clock_get_hz(clk_sys) / SHIFT_REGISTER_CYCLES_PER_BIT;
+  for (uint32_t hz = SHIFT_REGISTER_CLOCK_HZ; shiftBackend == SHIFT_BACKEND_PIO && hz <= maxShiftHz; hz += hz / 4) {
+    setShiftClock(hz);
+    if (!calibrationCheck(scratch, EEPROM_SECTOR_SIZE, false) || !calibrationCheck(scratch, EEPROM_SECTOR_SIZE, true)) {
+      break;
+    }
+    shiftHz = hz;
+  }
+  setShiftClock(SHIFT_REGISTER_CLOCK_HZ);
+  printf("  Shift clock: %lu Hz passes (default %lu Hz)\n", shiftHz, SHIFT_REGISTER_CLOCK_HZ);
+
+  // Read access delay after the latch:
+  uint32_t readAccess = datasheet.readAccess;
+  for (uint32_t cycles = datasheet.readAccess; ; cycles--) {
+    busTiming.readAccess = cycles;
+    if (!calibrationCheck(scratch, EEPROM_SECTOR_SIZE, false)) { break; }
+    readAccess = cycles;
+    if (cycles == 0) { break; }
+  }
+  busTiming.readAccess = datasheet.readAccess;
+  printf("  Read access: %lu cycles pass (datasheet %lu)\n", readAccess, datasheet.readAccess);
+
+  // Back off by the margin. The shift clock gets it on its period.
+  uint32_t shiftPeriodNs = withCalibrationMargin(1000000000u / shiftHz, 1000000000u / SHIFT_REGISTER_CLOCK_HZ);
+  calibration.shiftClockHz = 1000000000u / shiftPeriodNs;
+  calibration.writePulseNs = withCalibrationMargin(cyclesToNs(writePulse), cyclesToNs(datasheet.writePulse));
+  calibration.readAccessNs = withCalibrationMargin(cyclesToNs(readAccess), busReadAccessNs(eepromTiming));
+  calibration.shiftBackend = shiftBackend;
+  calibration.chipId = chipCalibrationId(chip);
+  calibration.marginPercent = calibrationMarginPercent;
+
+  // Check the final timing end to end before keeping it:
+  applyBusCalibration(&calibration);
+  bool ok = calibrationProgram(scratch, EEPROM_SECTOR_SIZE) && calibrationCheck(scratch, EEPROM_SECTOR_SIZE, false) &&
+            calibrationCheck(scratch, EEPROM_SECTOR_SIZE, true);
+  setWriteMode();
+  EEPROM_sectorErase(scratch);
+  inlineVerify = wasInlineVerify;
+  if (!ok) {
+    datasheetCalibration(&calibration);
+    applyBusCalibration(&calibration);
+    printf("Calibrated timing failed the final check, staying on the datasheet timing.\n");
+    oledDisplayMessages("Error! Calibration", "final check failed.", "", "", "");
+    handleErr();
+    return;
+  }
+
+  printf("Calibrated (%s backend) with %lu%% margin: shift clock %lu Hz, /WE pulse %lu ns, read access %lu ns.\n",
+         shiftBackend == SHIFT_BACKEND_PIO ? "PIO" : "bit-bang", calibration.marginPercent,
+         calibration.shiftClockHz, calibration.writePulseNs, calibration.readAccessNs);
+  if (!calibrationSave(&calibration)) {
+    printf("Could not save the calibration to flash, it only applies until the next reset.\n");
+  }
+  oledDisplayMessages("Done calibrating", "see serial port", "", "", "");
+}
+
+/// @brief EEPROM_planUpdate() compares every sector of the image against the EEPROM and decides
+///        whether each one can be skipped, only needs programming, or needs an erase first. It
+///        then picks a full chip erase instead if that is estimated to be cheaper. Note a chip erase
+///        also blanks everything past the end of the image.
+/// @param fil The image file
+/// @param plan The plan to fill in
+void EEPROM_planUpdate(FIL* fil, UpdatePlan* plan) {
+  static uint16_t programBytes[MAX_EEPROM_SECTORS];  // Bytes to program in place, per sector
+  static uint16_t nonBlankBytes[MAX_EEPROM_SECTORS]; // Bytes to program after an erase, per sector
+  static bool needsErase[MAX_EEPROM_SECTORS];
+  memset(plan, 0, sizeof(UpdatePlan));
+  uint32_t imageProgramBytes = 0; // Bytes that need programming after a chip erase (not 0xFF)
+  setReadMode();
+
+  for (uint32_t sector = 0; sector < chipSectorCount(); sector++) {
+    UINT length = readImageSector(fil, sector);
+    if (length == 0) { break; }
+    readChipSector(sector, length);
+
+    programBytes[sector] = 0;
+    nonBlankBytes[sector] = 0;
+    needsErase[sector] = false;
+    for (UINT i = 0; i < length; i++) {
+      ByteState state = classifyByte(chipSector[i], imageSector[i]);
+      needsErase[sector] |= state == BYTE_NEEDS_ERASE;
+      programBytes[sector] += state == BYTE_PROGRAMMABLE ? 1 : 0;
+      nonBlankBytes[sector] += imageSector[i] != 0xFF ? 1 : 0;
+    }
+
+    imageProgramBytes += nonBlankBytes[sector];
+    plan->sectorCount += 1;
+    if (length < EEPROM_SECTOR_SIZE) { break; }
+  }
+
+  // A sector erase takes all our sectors in that erase sector with it, so they go together:
+  for (uint32_t first = 0; first < plan->sectorCount; first += sectorsPerErase()) {
+    uint32_t end = first + sectorsPerErase() < plan->sectorCount ? first + sectorsPerErase() : plan->sectorCount;
+    bool eraseNeeded = false;
+    for (uint32_t sector = first; sector < end; sector++) {
+      eraseNeeded |= needsErase[sector];
+    }
+
+    if (eraseNeeded) {
+      plan->sectorPlanUs += chip->sectorEraseTypicalUs;
+    }
+    for (uint32_t sector = first; sector < end; sector++) {
+      if (eraseNeeded) {
+        plan->action[sector] = SECTOR_ERASE_PROGRAM;
+        plan->eraseSectors += 1;
+        plan->sectorPlanUs += nonBlankBytes[sector] * chip->byteProgramTypicalUs;
+      } else if (programBytes[sector] > 0) {
+        plan->action[sector] = SECTOR_PROGRAM;
+        plan->programSectors += 1;
+        plan->sectorPlanUs += programBytes[sector] * chip->byteProgramTypicalUs;
+      } else {
+        plan->action[sector] = SECTOR_SKIP;
+        plan->skipSectors += 1;
+      }
+    }
+  }
+
+  plan->chipPlanUs = chip->chipEraseTypicalUs + imageProgramBytes * chip->byteProgramTypicalUs;
+  plan->useChipErase = plan->chipPlanUs < plan->sectorPlanUs;
+  printf("Update plan: %lu sectors, %lu skip, %lu program, %lu erase+program.\n",
+         plan->sectorCount, plan->skipSectors, plan->programSectors, plan->eraseSectors);
+  printf("Estimated %lu ms sector by sector vs %lu ms with a chip erase, using %s.\n",
+         plan->sectorPlanUs / 1000, plan->chipPlanUs / 1000, plan->useChipErase ? "chip erase" : "sectors");
+}
+
+/// @brief EEPROM_UpdateFromFile() brings the EEPROM in line with the image file, only touching
+///        sectors that actually changed (or doing a chip erase if the planner says so).
+/// @param fil The image file
+/// @return true on success
+bool EEPROM_UpdateFromFile(FIL* fil) {
+  static UpdatePlan plan;
+  if (!imageFitsChip(fil)) {
+    return false;
+  }
+
+  if (chip->pageSize > 0) { // Byte alterable, nothing to plan: a bit-compatible write only touches pages that differ
+    ProgramMode previousMode = programMode;
+    programMode = PROGRAM_BIT_COMPATIBLE;
+    EEPROM_WriteCurrentFile(fil);
+    programMode = previousMode;
+    return true;
+  }
+
+  oledDisplayMessages("Planning", "EEPROM update", "now...", "", "");
+  EEPROM_planUpdate(fil, &plan);
+
+  if (plan.useChipErase && !EEPROM_chipErase()) {
+    return false;
+  }
+
+  oledDisplayMessages("Updating", "EEPROM", "now...", "", "");
+  for (uint32_t sector = 0; sector < plan.sectorCount; sector++) {
+    SectorAction action = plan.useChipErase ? SECTOR_ERASE_PROGRAM : plan.action[sector];
+    if (action == SECTOR_SKIP) { continue; }
+
+    UINT length = readImageSector(fil, sector);
+    if (action == SECTOR_PROGRAM) {
+      setReadMode();
+      readChipSector(sector, length);
+    } else {
+      memset(chipSector, 0xFF, length); // Erased
+    }
+
+    setWriteMode();
+    if (action == SECTOR_ERASE_PROGRAM && !plan.useChipErase && sector % sectorsPerErase() == 0 &&
+        !EEPROM_sectorErase(sector * EEPROM_SECTOR_SIZE)) { // Once per erase sector, at its first sector
+      return false;
+    }
+
+    EEPROM_beginBulkProgram();
+    bool programmed = programImageSector(sector, length);
+    EEPROM_endBulkProgram();
+    if (!programmed) {
+      return false;
+    }
+  }
+
+  char stringTwo[32];
+  char stringThree[32];
+  sprintf(stringTwo, "Skipped: %lu", plan.useChipErase ? 0 : plan.skipSectors);
+  sprintf(stringThree, "Erased: %lu", plan.useChipErase ? plan.sectorCount : plan.eraseSectors);
+  oledDisplayMessages("Done updating", "EEPROM! Sectors:", stringTwo, stringThree, "");
+  return true;
+}
+
+/// @brief gangDetect() detects the part in each of the fitted sockets on its own, and puts the ones
+///        that hold the same flash part as the first into gangSockets. Sockets that are empty or
+///        hold a different part are left out. The AT28C parts have no erase command and poll per
+///        page, so they are left out too.
+/// @param sockets The sockets to try, one bit each
+/// @return false if no socket is usable, chip is left at socket 0's part then
+bool gangDetect(uint32_t sockets) {
+  const ChipInfo* gangChip = NULL;
+  gangSockets = 0;
+  for (uint32_t socket = 0; socket < socketCount; socket++) {
+    socketFailedAddress[socket] = 0;
+    socketMismatches[socket] = 0;
+    if ((sockets & (1u << socket)) == 0) { continue; }
+
+    selectSockets(1u << socket, socket);
+    if (!EEPROM_detectChip() || chip->family == CHIP_FAMILY_ATMEL || (gangChip != NULL && chip != gangChip)) {
+      printf("Socket %lu: no usable part, left out.\n", socket);
+      continue;
+    }
+    gangChip = chip;
+    gangSockets |= 1u << socket;
+  }
+
+  chip = gangChip;
+  useChipTiming();
+  if (gangSockets == 0) {
+    selectSockets(0x1, 0);
+    EEPROM_detectChip();
+    return false;
+  }
+  return true;
+}
+
+/// @brief gangChipErase() chip erases every socket in gangSockets with one erase sequence, and
+///        waits for each of them. Sockets that fail are dropped.
+void gangChipErase() {
+  oledDisplayMessages("Gang erasing", "EEPROMs", "now...", "", "");
+  selectSockets(gangSockets, firstSocket(gangSockets));
+  setWriteMode();
+  EEPROM_chipEraseCommand();
+  gangWaitForCompletion(0, 0xFF, chip->chipEraseMaxUs * ERASE_TIMEOUT_FACTOR);
+}
+
+/// @brief gangVerifySocket() reads one socket back against its file, one socket at a time as
+///        the reads can't be shared. The mismatches go in socketMismatches.
+void gangVerifySocket(uint32_t socket, FIL* fil) {
+  selectSockets(1u << socket, socket);
+  mismatchCount = 0;
+  f_rewind(fil);
+  BusCommand verify;
+  busStreamFile(fil, BUS_CMD_VERIFY, &verify);
+  socketMismatches[socket] = mismatchCount;
+  socketFirstMismatch[socket] = mismatchCount > 0 ? recordedMismatches[0].address : 0;
+}
+
+/// @brief gangReport() prints a pass / fail for each socket that started the job, and puts the
+///        totals on the OLED. Leaves socket 0 selected again.
+/// @param startSockets The sockets the job started with
+/// @param address The number of bytes written, for the OLED
+void gangReport(uint32_t startSockets, uint32_t address) {
+  uint32_t passed = 0;
+  for (uint32_t socket = 0; socket < socketCount; socket++) {
+    if ((startSockets & (1u << socket)) == 0) { continue; }
+    if ((gangSockets & (1u << socket)) == 0) {
+      printf("Socket %lu: FAIL, program / erase / SD read failed at 0x%05lX\n", socket, socketFailedAddress[socket]);
+    } else if (socketMismatches[socket] > 0) {
+      printf("Socket %lu: FAIL, %lu mismatches, the first at 0x%05lX\n", socket, socketMismatches[socket],
+             socketFirstMismatch[socket]);
+    } else {
+      printf("Socket %lu: PASS\n", socket);
+      passed += 1;
+    }
+  }
+
+  selectSockets(0x1, 0);
+  char stringTwo[32];
+  char stringThree[32];
+  sprintf(stringTwo, "Passed: %lu of %lu", passed, (uint32_t)__builtin_popcount(startSockets));
+  sprintf(stringThree, "Addrs: 0x%05lX", address);
+  oledDisplayMessages("Done gang writing!", stringTwo, stringThree, "", "");
+  sleep_ms(5000);
+}
+
+/// @brief EEPROM_GangWriteFile() programs the file into every fitted socket at once. The chips are
+///        chip erased together, programmed together, and then checked one at a time, with a
+///        pass / fail per socket at the end. See gangDetect() for which sockets take part.
+/// @param fil The file to write
+void EEPROM_GangWriteFile(FIL* fil) {
+  if (!gangDetect((1u << socketCount) - 1)) {
+    return;
+  }
+
+  if (!imageFitsChip(fil)) {
+    selectSockets(0x1, 0);
+    return;
+  }
+
+  uint32_t startSockets = gangSockets;
+  printf("Gang writing %s to sockets 0x%lX.\n", chip->name, gangSockets);
+  gangChipErase();
+
+  oledDisplayMessages("Gang writing", "to EEPROMs", "now...", "", "");
+  memset(&busStats, 0, sizeof(busStats));
+  BusCommand result = { .ok = true };
+  uint32_t address = gangSockets != 0 ? busStreamFile(fil, BUS_CMD_GANG_PROGRAM, &result) : 0;
+  printCycleTime("gang programmed", busStats.programmedBytes, busStats.busyUs);
+
+  for (uint32_t socket = 0; socket < MAX_SOCKETS && !inlineVerify; socket++) {
+    if (gangSockets & (1u << socket)) {
+      gangVerifySocket(socket, fil);
+    }
+  }
+
+  gangReport(startSockets, address);
+}
+
+/// @brief readInterleavedBlock() reads the next block of every socket's file into its slot of
+///        blocks, padding short reads with 0xFF so the bus engine skips them. A socket whose file
+///        can't be read is marked failed at address and added to readFailed, for the caller to
+///        drop like one core1 failed.
+/// @param sockets The sockets still in the job
+/// @param address Where the block goes, for the report
+/// @param readFailed Gets the sockets whose read failed
+/// @return The longest read, 0 once every file has ended
+uint32_t readInterleavedBlock(FIL* fils, uint8_t* blocks[], uint32_t sockets, uint32_t address,
+                              uint32_t* readFailed) {
+  uint32_t length = 0;
+  for (uint32_t socket = 0; socket < MAX_SOCKETS; socket++) {
+    if ((sockets & (1u << socket)) == 0) { continue; }
+
+    UINT bytesRead = 0;
+    if (sdStreamRead(&fils[socket], blocks[socket], SD_STREAM_BLOCK_SIZE, &bytesRead, SD_slowDown) != FR_OK) {
+      printf("SD Error! f_read failed for socket %lu at 0x%05lX, dropped.\n", socket, address);
+      *readFailed |= 1u << socket;
+      socketFailedAddress[socket] = address;
+      continue;
+    }
+    memset(blocks[socket] + bytesRead, 0xFF, SD_STREAM_BLOCK_SIZE - bytesRead);
+    length = bytesRead > length ? bytesRead : length;
+  }
+  return length;
+}
+
+/// @brief EEPROM_InterleavedWriteFiles() programs each fitted socket with its own file from
+///        SOCKET_FILE_NAMES. The chips are chip erased together, then core1 interleaves the byte
+///        programs across the sockets (see busInterleavedProgram()) while core0 reads the next
+///        block of every file. Pass / fail per socket at the end, like gang writing.
+void EEPROM_InterleavedWriteFiles() {
+  static FIL fils[MAX_SOCKETS];
+  uint8_t* blocks[2][MAX_SOCKETS] = { { NULL } }; // Pool blocks, only for the sockets in the gang
+  uint32_t opened = 0;
+  for (uint32_t socket = 0; socket < socketCount; socket++) {
+    if (f_open(&fils[socket], SOCKET_FILE_NAMES[socket], FA_READ) != FR_OK) {
+      printf("Socket %lu: could not open %s, left out.\n", socket, SOCKET_FILE_NAMES[socket]);
+      continue;
+    }
+    opened |= 1u << socket;
+  }
+
+  if (gangDetect(opened)) {
+    for (uint32_t socket = 0; socket < MAX_SOCKETS; socket++) {
+      if ((gangSockets & (1u << socket)) && !imageFitsChip(&fils[socket])) {
+        gangSockets &= ~(1u << socket);
+      }
+    }
+  }
+
+  for (uint32_t socket = 0; socket < MAX_SOCKETS; socket++) {
+    if (gangSockets & (1u << socket)) {
+      blocks[0][socket] = blockPoolAcquire();
+      blocks[1][socket] = blockPoolAcquire();
+      if (blocks[1][socket] == NULL) { // Both NULL or just the second, the release takes either
+        printf("Socket %lu: no free blocks in the pool, left out.\n", socket);
+        blockPoolRelease(blocks[0][socket]);
+        blocks[0][socket] = NULL;
+        gangSockets &= ~(1u << socket);
+      }
+    }
+  }
+
+  uint32_t startSockets = gangSockets;
+  uint32_t address = 0;
+  if (startSockets != 0) {
+    printf("Interleaved writing %s in sockets 0x%lX.\n", chip->name, gangSockets);
+    gangChipErase();
+
+    oledDisplayMessages("Interleaved", "writing", "EEPROMs now...", "", "");
+    memset(&busStats, 0, sizeof(busStats));
+    BusCommand result = { .ok = true };
+    uint32_t sockets = gangSockets; // Only core0 touches this, core1 reports its drops in the result
+    uint32_t buffer = 0;
+    bool inFlight = false;
+    while (result.ok && sockets != 0) { // Fill one set of blocks while core1 programs the other
+      uint32_t readFailed = 0;
+      uint32_t length = readInterleavedBlock(fils, blocks[buffer], sockets, address, &readFailed);
+      if (inFlight) {
+        busWaitResult(&result);
+        sockets &= ~result.failedSockets;
+        inFlight = false;
+      }
+      sockets &= ~readFailed;
+      if (length == 0 || !result.ok || sockets == 0) { break; }
+
+      BusCommand command = { .type = BUS_CMD_INTERLEAVED_PROGRAM, .address = address,
+                             .length = length, .sockets = sockets };
+      memcpy(command.socketData, blocks[buffer], sizeof(command.socketData)); // The pointers only
+      busSubmit(&command);
+      inFlight = true;
+      address += length;
+      buffer ^= 1;
+    }
+    if (inFlight) {
+      busWaitResult(&result);
+      sockets &= ~result.failedSockets;
+    }
+    gangSockets = sockets;
+    printCycleTime("interleaved programmed", busStats.programmedBytes, busStats.busyUs);
+  }
+  for (uint32_t socket = 0; socket < MAX_SOCKETS; socket++) { // core1 is done with them
+    blockPoolRelease(blocks[0][socket]);
+    blockPoolRelease(blocks[1][socket]);
+  }
+
+  if (startSockets != 0) {
+    for (uint32_t socket = 0; socket < MAX_SOCKETS && !inlineVerify; socket++) {
+      if (gangSockets & (1u << socket)) {
+        gangVerifySocket(socket, &fils[socket]);
+      }
+    }
+    gangReport(startSockets, address);
+  }
+
+  selectSockets(0x1, 0);
+  for (uint32_t socket = 0; socket < socketCount; socket++) {
+    if (opened & (1u << socket)) {
+      f_close(&fils[socket]);
+    }
+  }
+}
+
 /// @brief sd_routine - Work in progress SD Card routine. Reads, erases, writes to EEPROM and SD stuff.
 void sd_routine(char* fileName) {
   FATFS fat_fs;
@@ -517,9 +3138,12 @@ void sd_routine(char* fileName) {
   SD_openFile(&fil1, fileName, FA_READ);
   
   oledDisplayMessages("Performing", "Chip Erase", "", "", "");
-  EEPROM_chipErase();
+  if (!EEPROM_detectChip() || !EEPROM_chipErase()) {
+    SD_closeFile(&fil1);
+    SD_unmount();
+    return;
+  }
   oledDisplayMessages("Chip Erase", "Done!", "", "", "");
-  sleep_ms(1000);
   oledDisplayMessages("Verifying", "EEPROM", "is", "fully", "erased...");
   sleep_ms(200);
   EEPROM_VerifyErased();
@@ -530,24 +3154,51 @@ void sd_routine(char* fileName) {
   EEPROM_WriteCurrentFile(&fil1);
   oledDisplayMessages("Done", " writing EEPROM!", "", "", "");
 
-  sleep_ms(1000);
-  oledDisplayMessages("Verifying", "EEPROM now...", "", "", "");
-  sleep_ms(1000);
+  if (!inlineVerify) { // Otherwise every byte was already verified as it was written
+    sleep_ms(1000);
+    oledDisplayMessages("Verifying", "EEPROM now...", "", "", "");
+    sleep_ms(1000);
 
-  SD_closeFile(&fil1); // Close the first file
-  FIL fil2;
-  SD_openFile(&fil2, fileName, FA_READ); // Open again with a fresh reference
-  EEPROM_ReadAndVerify(&fil2);
+    f_rewind(&fil1);
+    EEPROM_ReadAndVerify(&fil1);
+  }
   sleep_ms(60000);
 
   // Now clean up after ourselves:
   sleep_ms(100);
-  SD_closeFile(&fil2);
+  SD_closeFile(&fil1);
   sleep_ms(100);
   SD_unmount();
   sleep_ms(100);
 }
 
+/// @brief printMenu() lists the serial commands. The OLED only has room for the main ones.
+void printMenu() {
+  printf("\nCommands:\n");
+  printf("  r - read ROM and verify it against %s\n", ROM_FILE_NAME);
+  printf("  w - write %s to ROM\n", ROM_FILE_NAME);
+  printf("  u - update ROM from %s, only touching sectors that changed\n", ROM_FILE_NAME);
+  printf("  o - dump ROM to %s\n", DUMP_FILE_NAME);
+  printf("  e - erase ROM\n");
+  printf("  v - verify ROM is erased\n");
+  printf("  m - toggle the write mode (bit-compatible / program every byte)\n");
+  printf("  i - toggle inline verify while writing\n");
+  printf("  p - toggle the shift register backend (PIO / bit-bang)\n");
+  printf("  h - toggle the bus HAL (SIO masked / per-pin)\n");
+  printf("  g - gang write %s to every fitted socket at once\n", ROM_FILE_NAME);
+  printf("  x - interleaved write: socketN.bin to socket N, for every fitted socket\n");
+  printf("  n - set the number of sockets fitted for gang writing (1 - %d)\n", MAX_SOCKETS);
+  printf("  a - select the part by hand (for parts without a Software ID), or back to auto detect\n");
+  printf("  z - toggle AT28C software data protection (turning it off sends the disable sequence)\n");
+  printf("  c - calibrate the bus timing for this board (erases the last sector)\n");
+  printf("  d - forget the calibration, back to datasheet timing\n");
+  printf("  b - toggle the bulk program engine (PIO + DMA / CPU)\n");
+  printf("  l - toggle the pipelined bus (shift the next address during the current access)\n");
+  printf("  k - benchmark bus cycle time, both bus modes (erases the last sector)\n");
+  printf("  s - benchmark SD card reads of %s at each SD clock, and seeks in it\n", ROM_FILE_NAME);
+  printf("  q - unmount SD card and quit\n");
+}
+
 /// @brief main - program entrypoint
 /// @return exit code
 int main() {
@@ -563,33 +3214,141 @@ int main() {
   
   while (true) { 
     oledDisplayMessages("Use serial port", "r - read ROM", "w - write ROM", "e - erase ROM", "v - verify erased");
+    printMenu();
     buf[0] = getchar(); // Wait for user to press 'enter' to continue
-    if (buf[0] == 'r') {
+    if (buf[0] == 'r' && EEPROM_detectChip()) {
       FIL myFil;
-      SD_openFile(&myFil, "marioduck.nes", FA_READ);
+      SD_openFile(&myFil, ROM_FILE_NAME, FA_READ);
       EEPROM_ReadAndVerify(&myFil);
       SD_closeFile(&myFil);
       sleep_ms(3000);
     }
 
-    if (buf[0] == 'w') {
+    if (buf[0] == 'w' && EEPROM_detectChip()) {
       FIL writeFil;
-      SD_openFile(&writeFil, "marioduck.nes", FA_READ);
+      SD_openFile(&writeFil, ROM_FILE_NAME, FA_READ);
       EEPROM_WriteCurrentFile(&writeFil);
       SD_closeFile(&writeFil);
       sleep_ms(3000);
     }
 
-    if (buf[0] == 'e') {
-      EEPROM_chipErase();
+    if (buf[0] == 'u' && EEPROM_detectChip()) {
+      FIL updateFil;
+      SD_openFile(&updateFil, ROM_FILE_NAME, FA_READ);
+      EEPROM_UpdateFromFile(&updateFil);
+      SD_closeFile(&updateFil);
+      sleep_ms(3000);
+    }
+
+    if (buf[0] == 'g') { // Detects each socket itself
+      FIL gangFil;
+      SD_openFile(&gangFil, ROM_FILE_NAME, FA_READ);
+      EEPROM_GangWriteFile(&gangFil);
+      SD_closeFile(&gangFil);
       sleep_ms(3000);
     }
 
-    if (buf[0] == 'v') {
+    if (buf[0] == 'x') { // Detects each socket itself
+      EEPROM_InterleavedWriteFiles();
+      sleep_ms(3000);
+    }
+
+    if (buf[0] == 'n') {
+      socketCount = socketCount % MAX_SOCKETS + 1;
+      printf("Sockets fitted: %lu\n", socketCount);
+    }
+
+    if (buf[0] == 'o' && EEPROM_detectChip()) {
+      FIL dumpFil;
+      if (SD_openFile(&dumpFil, DUMP_FILE_NAME, FA_WRITE | FA_CREATE_ALWAYS)) {
+        EEPROM_DumpToFile(&dumpFil);
+        SD_closeFile(&dumpFil);
+      }
+      sleep_ms(3000);
+    }
+
+    if (buf[0] == 'e' && EEPROM_detectChip()) {
+      EEPROM_chipErase();
+    }
+
+    if (buf[0] == 'v' && EEPROM_detectChip()) {
       EEPROM_VerifyErased();
       sleep_ms(3000);
     }
 
+    if (buf[0] == 'p') {
+      setShiftBackend(shiftBackend == SHIFT_BACKEND_PIO ? SHIFT_BACKEND_BITBANG : SHIFT_BACKEND_PIO);
+      applyBusCalibration(&busCalibration); // Calibrated timing only holds for the backend it was measured on
+      printf("Shift backend: %s\n", shiftBackend == SHIFT_BACKEND_PIO ? "PIO" : "bit-bang");
+    }
+
+    if (buf[0] == 'h') {
+      busHal = busHal == BUS_HAL_SIO ? BUS_HAL_PER_PIN : BUS_HAL_SIO;
+      printf("Bus HAL: %s\n", busHal == BUS_HAL_SIO ? "SIO masked" : "per-pin");
+    }
+
+    if (buf[0] == 'a') { // Cycles through the parts that can't be detected, then back to auto
+      size_t next = manualChip == NULL ? 0 : (size_t)(manualChip - CHIP_TABLE) + 1;
+      while (next < CHIP_TABLE_LENGTH && CHIP_TABLE[next].family != CHIP_FAMILY_ATMEL) {
+        next++;
+      }
+      manualChip = next < CHIP_TABLE_LENGTH ? &CHIP_TABLE[next] : NULL;
+      printf("Part: %s\n", manualChip != NULL ? manualChip->name : "auto detect");
+    }
+
+    if (buf[0] == 'z') {
+      softwareDataProtection = !softwareDataProtection;
+      if (!softwareDataProtection && EEPROM_detectChip() && chip->family == CHIP_FAMILY_ATMEL) {
+        EEPROM_disableDataProtection();
+      }
+      printf("Software data protection: %s\n", softwareDataProtection ? "on" : "off");
+    }
+
+    if (buf[0] == 'c' && EEPROM_detectChip()) {
+      EEPROM_calibrateBus();
+      sleep_ms(3000);
+    }
+
+    if (buf[0] == 'd') {
+      BusCalibration calibration;
+      datasheetCalibration(&calibration);
+      applyBusCalibration(&calibration);
+      printf("Bus timing: datasheet%s\n", calibrationErase() ? "" : " (could not erase the stored calibration)");
+    }
+
+    if (buf[0] == 'b') {
+      bulkProgramEngine = !bulkProgramEngine;
+      printf("Bulk program engine: %s\n", bulkProgramEngine ? "PIO + DMA" : "CPU");
+    }
+
+    if (buf[0] == 'l') {
+      pipelinedBus = !pipelinedBus;
+      printf("Bus mode: %s\n", pipelinedBus ? "pipelined" : "sequential");
+    }
+
+    if (buf[0] == 'k' && EEPROM_detectChip()) {
+      EEPROM_benchmarkBus();
+      sleep_ms(3000);
+    }
+
+    if (buf[0] == 's') {
+      FIL benchmarkFil;
+      SD_openFile(&benchmarkFil, ROM_FILE_NAME, FA_READ);
+      SD_benchmark(&benchmarkFil);
+      SD_closeFile(&benchmarkFil);
+      sleep_ms(3000);
+    }
+
+    if (buf[0] == 'm') {
+      programMode = programMode == PROGRAM_BIT_COMPATIBLE ? PROGRAM_ALL : PROGRAM_BIT_COMPATIBLE;
+      printf("Program mode: %s\n", programMode == PROGRAM_BIT_COMPATIBLE ? "bit-compatible" : "program all");
+    }
+
+    if (buf[0] == 'i') {
+      inlineVerify = !inlineVerify;
+      printf("Inline verify: %s\n", inlineVerify ? "on" : "off");
+    }
+
     if (buf[0] == 'q') {
       SD_unmount();
       return 0;
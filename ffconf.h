@@ -0,0 +1,76 @@
+/* ffconf.h
+   This project's FatFs R0.15 configuration, used instead of the one that comes with the
+   no-OS-FatFS-SD-SPI-RPi-Pico library. ff.h includes "ffconf.h" from its own directory first,
+   so CMakeLists.txt copies this file over the library's when the build is configured.
+
+   Compared to the library's defaults it turns on fast seek (FF_USE_FASTSEEK, the image link
+   maps) and contiguous allocation (FF_USE_EXPAND, the chip dump). The rest keeps what the
+   library's own sources (ff_stdio.c, glue.c) need.
+*/
+
+/*---------------------------------------------------------------------------/
+/  Configurations of FatFs Module
+/---------------------------------------------------------------------------*/
+
+#define FFCONF_DEF	80286	/* Revision ID */
+
+/*---------------------------------------------------------------------------/
+/ Function Configurations
+/---------------------------------------------------------------------------*/
+
+#define FF_FS_READONLY	0
+#define FF_FS_MINIMIZE	0
+#define FF_USE_FIND		1
+#define FF_USE_MKFS		1
+#define FF_USE_FASTSEEK	1	/* SD_fastSeek(): cluster link maps for the image files */
+#define FF_USE_EXPAND	1	/* EEPROM_DumpToFile(): the dump file in one contiguous run */
+#define FF_USE_CHMOD	1
+#define FF_USE_LABEL	1
+#define FF_USE_FORWARD	0
+#define FF_USE_STRFUNC	1
+#define FF_PRINT_LLI	1
+#define FF_PRINT_FLOAT	1
+#define FF_STRF_ENCODE	3
+
+/*---------------------------------------------------------------------------/
+/ Locale and Namespace Configurations
+/---------------------------------------------------------------------------*/
+
+#define FF_CODE_PAGE	437
+#define FF_USE_LFN		3
+#define FF_MAX_LFN		255
+#define FF_LFN_UNICODE	0
+#define FF_LFN_BUF		255
+#define FF_SFN_BUF		12
+#define FF_FS_RPATH		2
+
+/*---------------------------------------------------------------------------/
+/ Drive/Volume Configurations
+/---------------------------------------------------------------------------*/
+
+#define FF_VOLUMES		4
+#define FF_STR_VOLUME_ID	0
+#define FF_VOLUME_STRS		"RAM","NAND","CF","SD","SD2","USB","USB2","USB3"
+#define FF_MULTI_PARTITION	0
+#define FF_MIN_SS		512
+#define FF_MAX_SS		512
+#define FF_LBA64		1
+#define FF_MIN_GPT		0x10000000
+#define FF_USE_TRIM		0
+
+/*---------------------------------------------------------------------------/
+/ System Configurations
+/---------------------------------------------------------------------------*/
+
+#define FF_FS_TINY		0
+#define FF_FS_EXFAT		1
+#define FF_FS_NORTC		0
+#define FF_NORTC_MON	1
+#define FF_NORTC_MDAY	1
+#define FF_NORTC_YEAR	2022
+#define FF_FS_NOFSINFO	0
+#define FF_FS_LOCK		0
+#define FF_FS_REENTRANT	0
+#define FF_FS_TIMEOUT	1000
+
+/*--- End of configuration options ---*/
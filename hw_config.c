@@ -62,9 +62,9 @@ static spi_t spis[] = {  // One for each SPI.
         .mosi_gpio = 19,
         .sck_gpio = 18,
 
-        // .baud_rate = 1000 * 1000
-        .baud_rate = 12500 * 1000
-        // .baud_rate = 25 * 1000 * 1000 // Actual frequency: 20833333.
+        // The safe rate the card is mounted at. SD_mount() then raises it to the fastest rate in
+        // SD_CLOCK_RATES_HZ that passes a multi-block read self-test (see SD_negotiateClock()).
+        .baud_rate = 1000 * 1000
     }};
 
 // Hardware Configuration of the SD Card "objects"
@@ -0,0 +1,129 @@
+/* sd_stream.c
+   Double-buffered streaming reader for image files on the SD card, see sd_stream.h.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "sd_stream.h"
+
+FRESULT sdStreamRead(FIL* fil, void* buffer, UINT length, UINT* bytesRead, bool (*slowDown)(void)) {
+  FSIZE_t offset = f_tell(fil);
+  FRESULT result = f_read(fil, buffer, length, bytesRead);
+  while (result == FR_DISK_ERR && slowDown != NULL && slowDown()) {
+    fil->err = 0; // FatFs refuses every later call on the file until the hard error is cleared
+    result = f_lseek(fil, offset);
+    if (result == FR_OK) {
+      result = f_read(fil, buffer, length, bytesRead);
+    }
+  }
+  return result;
+}
+
+bool sdStreamOpen(SDStream* stream, FIL* fil, uint64_t (*clockUs)(void), bool (*slowDown)(void)) {
+  if (blockPoolAvailable() < SD_STREAM_BLOCK_COUNT) {
+    return false;
+  }
+  for (uint32_t i = 0; i < SD_STREAM_BLOCK_COUNT; i++) {
+    stream->blocks[i].data = blockPoolAcquire();
+  }
+
+  stream->fil = fil;
+  stream->clockUs = clockUs;
+  stream->slowDown = slowDown;
+  stream->fillIndex = 0;
+  stream->nextIndex = 0;
+  stream->readyCount = 0;
+  stream->busyCount = 0;
+  stream->fileOffset = f_tell(fil);
+  stream->endOfFile = false;
+  stream->error = FR_OK;
+  memset(&stream->stats, 0, sizeof(SDStreamStats));
+  stream->stats.minReadUs = UINT32_MAX;
+  stream->stats.startUs = clockUs();
+  return true;
+}
+
+void sdStreamClose(SDStream* stream) {
+  for (uint32_t i = 0; i < SD_STREAM_BLOCK_COUNT; i++) {
+    blockPoolRelease(stream->blocks[i].data);
+    stream->blocks[i].data = NULL;
+  }
+}
+
+bool sdStreamPrefetch(SDStream* stream) {
+  if (stream->endOfFile || stream->readyCount + stream->busyCount == SD_STREAM_BLOCK_COUNT) {
+    return false;
+  }
+
+  SDStreamBlock* block = &stream->blocks[stream->fillIndex];
+  uint64_t start = stream->clockUs();
+  FRESULT result = sdStreamRead(stream->fil, block->data, SD_STREAM_BLOCK_SIZE, &block->length,
+                                stream->slowDown);
+  uint32_t elapsedUs = (uint32_t)(stream->clockUs() - start);
+
+  stream->stats.reads += 1;
+  stream->stats.readUs += elapsedUs;
+  stream->stats.minReadUs = elapsedUs < stream->stats.minReadUs ? elapsedUs : stream->stats.minReadUs;
+  stream->stats.maxReadUs = elapsedUs > stream->stats.maxReadUs ? elapsedUs : stream->stats.maxReadUs;
+
+  if (result != FR_OK) {
+    stream->error = result;
+    stream->endOfFile = true;
+    return false;
+  }
+
+  if (block->length < SD_STREAM_BLOCK_SIZE) { // If we did not read a full block worth of info, we're done!
+    stream->endOfFile = true;
+  }
+
+  if (block->length == 0) {
+    return false;
+  }
+
+  block->offset = stream->fileOffset;
+  stream->fileOffset += block->length;
+  stream->stats.bytes += block->length;
+  stream->fillIndex = (stream->fillIndex + 1) % SD_STREAM_BLOCK_COUNT;
+  stream->readyCount += 1;
+  return true;
+}
+
+SDStreamBlock* sdStreamNext(SDStream* stream) {
+  if (stream->readyCount == 0) {
+    if (!sdStreamPrefetch(stream)) {
+      return NULL;
+    }
+    stream->stats.stallReads += 1;
+  }
+
+  SDStreamBlock* block = &stream->blocks[stream->nextIndex];
+  stream->nextIndex = (stream->nextIndex + 1) % SD_STREAM_BLOCK_COUNT;
+  stream->readyCount -= 1;
+  stream->busyCount += 1;
+  return block;
+}
+
+void sdStreamRelease(SDStream* stream) {
+  if (stream->busyCount > 0) {
+    stream->busyCount -= 1;
+  }
+}
+
+uint32_t sdStreamIndexOf(SDStream* stream, const SDStreamBlock* block) {
+  return (uint32_t)(block - stream->blocks);
+}
+
+void sdStreamPrintStats(SDStream* stream) {
+  SDStreamStats* stats = &stream->stats;
+  uint64_t totalUs = stream->clockUs() - stats->startUs;
+  uint32_t averageUs = stats->reads > 0 ? (uint32_t)(stats->readUs / stats->reads) : 0;
+  uint32_t readKBps = stats->readUs > 0 ? (uint32_t)(stats->bytes * 1000 / stats->readUs) : 0;
+  uint32_t overallKBps = totalUs > 0 ? (uint32_t)(stats->bytes * 1000 / totalUs) : 0;
+
+  printf("SD stream: %lu reads, %lu bytes, read latency min/avg/max %lu/%lu/%lu us.\n",
+         (unsigned long)stats->reads, (unsigned long)stats->bytes,
+         (unsigned long)(stats->reads > 0 ? stats->minReadUs : 0), (unsigned long)averageUs,
+         (unsigned long)stats->maxReadUs);
+  printf("SD stream: %lu KB/s while reading, %lu KB/s overall, %lu reads stalled the consumer.\n",
+         (unsigned long)readKBps, (unsigned long)overallKBps, (unsigned long)stats->stallReads);
+}
@@ -0,0 +1,99 @@
+/* sd_stream.h
+   Double-buffered (or more) streaming reader for image files on the SD card.
+
+   The file is read in EEPROM_SECTOR_SIZE (4KB) blocks at 4KB aligned offsets, which lines
+   up with the 39SF0X0 sectors and lets FatFs read whole SD sectors straight into our
+   buffers. The buffers are block_pool.h blocks, held from sdStreamOpen() to sdStreamClose().
+   While the consumer (the bus engine) is working on one block the next ones can be prefetched
+   with sdStreamPrefetch(). A read that fails with a disk error can be retried at a slower
+   SD clock, see sdStreamRead().
+
+   Blocks are handed out in file order by sdStreamNext() and must be given back in the
+   same order with sdStreamRelease(). Only FatFs is used here; tests/test_sd_stream.c runs
+   it on the host over a RAM disk.
+*/
+
+#ifndef _inc_sd_stream
+#define _inc_sd_stream
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ff.h"
+#include "block_pool.h"
+
+#define SD_STREAM_BLOCK_SIZE BLOCK_POOL_BLOCK_SIZE
+#define SD_STREAM_BLOCK_COUNT 4
+
+/// @brief One block of the file.
+typedef struct {
+  uint8_t* data;    // A pool block, owned by the stream while it is open
+  UINT length;     // Number of valid bytes in data
+  uint32_t offset; // File offset of data[0]
+} SDStreamBlock;
+
+/// @brief Read latency / throughput counters.
+typedef struct {
+  uint32_t reads;        // Number of f_read() calls
+  uint64_t bytes;        // Bytes read
+  uint64_t readUs;       // Total time spent in f_read()
+  uint32_t minReadUs;
+  uint32_t maxReadUs;
+  uint32_t stallReads;   // Reads the consumer had to wait for (nothing was prefetched)
+  uint64_t startUs;      // When the stream was opened
+} SDStreamStats;
+
+/// @brief The stream state. The buffers come from the block pool.
+typedef struct {
+  FIL* fil;
+  uint64_t (*clockUs)(void); // Microsecond clock for the stats
+  bool (*slowDown)(void);    // See sdStreamRead(), may be NULL
+  SDStreamBlock blocks[SD_STREAM_BLOCK_COUNT];
+  uint32_t fillIndex;    // Next block to read into
+  uint32_t nextIndex;    // Next block to hand out
+  uint32_t readyCount;   // Blocks read but not handed out yet
+  uint32_t busyCount;    // Blocks handed out but not released yet
+  uint32_t fileOffset;   // Offset of the next read
+  bool endOfFile;
+  FRESULT error;         // First f_read() error, FR_OK if none
+  SDStreamStats stats;
+} SDStream;
+
+/// @brief sdStreamOpen() starts streaming fil from its current position, taking its blocks
+///        from the block pool.
+/// @param stream The stream to set up
+/// @param fil An open file
+/// @param clockUs Returns the current time in microseconds (time_us_64 on the Pico)
+/// @param slowDown Lowers the SD clock after a failed read, see sdStreamRead(). May be NULL.
+/// @return false if the pool didn't have enough free blocks, nothing is held then
+bool sdStreamOpen(SDStream* stream, FIL* fil, uint64_t (*clockUs)(void), bool (*slowDown)(void));
+
+/// @brief sdStreamRead() is f_read() that retries a disk error (a bad CRC, a timeout) from the same
+///        file position for as long as slowDown() can still lower the SD clock.
+/// @param slowDown Lowers the SD clock one step, false once it is already at the slowest.
+///        NULL reads once, like f_read().
+FRESULT sdStreamRead(FIL* fil, void* buffer, UINT length, UINT* bytesRead, bool (*slowDown)(void));
+
+/// @brief sdStreamClose() gives the stream's blocks back to the block pool. Every handed out
+///        block must have been released first.
+void sdStreamClose(SDStream* stream);
+
+/// @brief sdStreamPrefetch() reads ahead into a free block, if there is one.
+/// @return true if a block was read, false if there was nothing to do.
+bool sdStreamPrefetch(SDStream* stream);
+
+/// @brief sdStreamNext() hands out the next block of the file, reading it now if it
+///        wasn't prefetched yet.
+/// @return The block, or NULL at the end of the file, on error, or if every block is
+///         still handed out.
+SDStreamBlock* sdStreamNext(SDStream* stream);
+
+/// @brief sdStreamRelease() gives the oldest handed out block back for reuse.
+void sdStreamRelease(SDStream* stream);
+
+/// @brief sdStreamIndexOf() returns the index of a block, handy as a tag.
+uint32_t sdStreamIndexOf(SDStream* stream, const SDStreamBlock* block);
+
+/// @brief sdStreamPrintStats() prints the read latency and throughput counters.
+void sdStreamPrintStats(SDStream* stream);
+
+#endif
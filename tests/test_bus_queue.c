@@ -0,0 +1,75 @@
+/* test_bus_queue.c
+   Pushes millions of commands through a BusQueue from one thread to another, the way core0 feeds
+   core1, and checks every one comes out once and in order. The queue is only 8 entries, so both
+   the full and the empty case, and the wraparound of the head / tail counters' slot index, are hit
+   over and over.
+*/
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "bus_queue.h"
+
+#define COMMAND_COUNT 4000000u
+
+static BusQueue queue;
+static uint32_t fullCount;  // Pushes that found the queue full
+static uint32_t emptyCount; // Pops that found the queue empty
+
+static void* producer(void* arg) {
+  (void)arg;
+  for (uint32_t i = 0; i < COMMAND_COUNT; i++) {
+    BusCommand command = { .type = BUS_CMD_PROGRAM, .address = i, .length = i * 7u, .tag = ~i };
+    while (!busQueuePush(&queue, &command)) {
+      fullCount++;
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+int main(void) {
+  busQueueInit(&queue);
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, producer, NULL) != 0) {
+    printf("FAIL: could not start the producer thread\n");
+    return 1;
+  }
+
+  uint32_t received = 0;
+  uint32_t outOfOrder = 0;
+  uint32_t corrupt = 0;
+  while (received < COMMAND_COUNT) {
+    BusCommand command;
+    if (!busQueuePop(&queue, &command)) {
+      emptyCount++;
+      sched_yield();
+      continue;
+    }
+    if (command.address != received) { // Lost, duplicated or reordered
+      if (outOfOrder++ < 10) {
+        printf("FAIL: got command %u, expected %u\n", command.address, received);
+      }
+    }
+    if (command.length != command.address * 7u || command.tag != ~command.address) { // Torn copy
+      corrupt++;
+    }
+    received++;
+  }
+  pthread_join(thread, NULL);
+
+  BusCommand extra;
+  bool leftOver = busQueuePop(&queue, &extra);
+  printf("%u commands, queue full %u times, empty %u times\n", received, fullCount, emptyCount);
+  if (outOfOrder > 0 || corrupt > 0 || leftOver) {
+    printf("FAIL: %u out of order, %u corrupt, %s left over\n", outOfOrder, corrupt, leftOver ? "some" : "none");
+    return 1;
+  }
+  if (fullCount == 0 || emptyCount == 0) {
+    printf("FAIL: the queue never ran %s\n", fullCount == 0 ? "full" : "empty");
+    return 1;
+  }
+  printf("bus_queue.h: all checks passed\n");
+  return 0;
+}
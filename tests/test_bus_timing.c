@@ -0,0 +1,133 @@
+/* test_bus_timing.c
+   Checks busTimingInit() at a few clk_sys values, for every part in chip_table.h and the worst
+   case: every wait has to cover each datasheet parameter it stands for, rounded up to whole
+   cycles but not by more than one.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "bus_timing.h"
+#include "chip_table.h"
+
+// Worked out by the preprocessor, so the bus code can use it for constants:
+_Static_assert(NS_TO_CYCLES(8, 125000000) == 1, "8ns is one cycle at 125MHz");
+_Static_assert(NS_TO_CYCLES(16, 125000000) == 2, "16ns is exactly two cycles at 125MHz");
+_Static_assert(NS_TO_CYCLES(17, 125000000) == 3, "17ns rounds up to three cycles at 125MHz");
+_Static_assert(NS_TO_CYCLES(0, 200000000) == 0, "no wait is no cycles");
+
+static int failures = 0;
+
+/// @brief One parameter a BusTiming field has to cover.
+typedef struct {
+  const char* name;
+  size_t field; // offsetof() into BusTiming
+  uint32_t ns;
+} Requirement;
+
+#define FIELD(name) offsetof(BusTiming, name)
+#define REQUIREMENT_COUNT 13
+
+/// @brief requirementsOf() lists what each BusTiming field has to cover for one part.
+static void requirementsOf(const EepromTiming* eeprom, Requirement* requirements) {
+  const Requirement all[REQUIREMENT_COUNT] = {
+    { "tSU (74HC595)", FIELD(shiftDataSetup), SHIFT_T_SU_NS },
+    { "tW (74HC595)", FIELD(shiftClockWidth), SHIFT_T_W_NS },
+    { "tREM (74HC595)", FIELD(shiftClockWidth), SHIFT_T_REM_NS },
+    { "tPD (74HC595) + tAS", FIELD(addressSetup), SHIFT_T_PD_NS + eeprom->addressSetupNs },
+    { "tWP", FIELD(writePulse), eeprom->writePulseNs },
+    { "tAH", FIELD(writePulse), eeprom->addressHoldNs },
+    { "tDS + level shifter", FIELD(writePulse), eeprom->dataSetupNs + LEVEL_SHIFT_T_PD_NS },
+    { "tWPH", FIELD(writePulseHigh), eeprom->writePulseHighNs },
+    { "tDH", FIELD(writePulseHigh), eeprom->dataHoldNs },
+    { "tPD (74HC595) + tACC + level shifter", FIELD(readAccess), SHIFT_T_PD_NS + eeprom->accessNs + LEVEL_SHIFT_T_PD_NS },
+    { "tOE + level shifter", FIELD(outputEnable), eeprom->outputEnableNs + LEVEL_SHIFT_T_PD_NS },
+    { "tDF", FIELD(outputDisable), eeprom->outputDisableNs },
+    { "tIDA", FIELD(idAccess), eeprom->idAccessNs },
+  };
+  for (size_t i = 0; i < REQUIREMENT_COUNT; i++) {
+    requirements[i] = all[i];
+  }
+}
+
+static uint32_t fieldOf(const BusTiming* timing, size_t field) {
+  return *(const uint32_t*)((const uint8_t*)timing + field);
+}
+
+static void checkPart(const char* name, const EepromTiming* eeprom, uint32_t sysHz) {
+  Requirement requirements[REQUIREMENT_COUNT];
+  requirementsOf(eeprom, requirements);
+  BusTiming timing;
+  busTimingInit(&timing, sysHz, eeprom);
+  if (timing.sysHz != sysHz) {
+    printf("FAIL %s at %lu Hz: sysHz is %lu\n", name, (unsigned long)sysHz, (unsigned long)timing.sysHz);
+    failures++;
+  }
+
+  for (size_t i = 0; i < REQUIREMENT_COUNT; i++) {
+    const Requirement* requirement = &requirements[i];
+    uint64_t cycles = fieldOf(&timing, requirement->field);
+    uint64_t coveredNs1e9 = cycles * 1000000000u;                 // ns * hz, so no rounding
+    uint64_t requiredNs1e9 = (uint64_t)requirement->ns * sysHz;
+    if (coveredNs1e9 < requiredNs1e9) {
+      printf("FAIL %s at %lu Hz: %s needs %lu ns, got %lu cycles\n", name, (unsigned long)sysHz,
+             requirement->name, (unsigned long)requirement->ns, (unsigned long)cycles);
+      failures++;
+    }
+
+    // The field is the longest of its requirements, rounded up by less than one cycle.
+    uint64_t longest = 0;
+    for (size_t j = 0; j < REQUIREMENT_COUNT; j++) {
+      if (requirements[j].field == requirement->field && (uint64_t)requirements[j].ns * sysHz > longest) {
+        longest = (uint64_t)requirements[j].ns * sysHz;
+      }
+    }
+    if (cycles > 0 && (cycles - 1) * 1000000000u >= longest) {
+      printf("FAIL %s at %lu Hz: %s is %lu cycles, one more than it needs\n", name, (unsigned long)sysHz,
+             requirement->name, (unsigned long)cycles);
+      failures++;
+    }
+  }
+}
+
+/// @brief checkWorstCase() checks EEPROM_TIMING_WORST_CASE, used before detection, is at least as
+///        slow as every part in every field, and that only the AT28C parts actually need it.
+static void checkWorstCase(void) {
+  const EepromTiming* worst = &EEPROM_TIMING_WORST_CASE;
+  const size_t fields = sizeof(EepromTiming) / sizeof(uint32_t);
+  for (size_t i = 0; i < CHIP_TABLE_LENGTH; i++) {
+    const uint32_t* part = (const uint32_t*)&CHIP_TABLE[i].timing;
+    bool faster = false;
+    for (size_t field = 0; field < fields; field++) {
+      if (part[field] > ((const uint32_t*)worst)[field]) {
+        printf("FAIL %s: timing field %zu is %lu ns, more than the worst case\n", CHIP_TABLE[i].name, field,
+               (unsigned long)part[field]);
+        failures++;
+      }
+      faster = faster || part[field] < ((const uint32_t*)worst)[field];
+    }
+    if (faster != (CHIP_TABLE[i].family != CHIP_FAMILY_ATMEL)) {
+      printf("FAIL %s: %s the worst case timing\n", CHIP_TABLE[i].name, faster ? "is faster than" : "runs at");
+      failures++;
+    }
+  }
+}
+
+int main(void) {
+  const uint32_t clocks[] = { 125000000, 133000000, 200000000 };
+  for (size_t i = 0; i < sizeof(clocks) / sizeof(clocks[0]); i++) {
+    checkPart("worst case", &EEPROM_TIMING_WORST_CASE, clocks[i]);
+    for (size_t part = 0; part < CHIP_TABLE_LENGTH; part++) {
+      checkPart(CHIP_TABLE[part].name, &CHIP_TABLE[part].timing, clocks[i]);
+    }
+  }
+  checkWorstCase();
+
+  if (failures > 0) {
+    printf("%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("bus_timing.h, chip_table.h: all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,287 @@
+/* test_sd_stream.c
+   Runs sd_stream.c on FatFs itself, over a RAM disk formatted by f_mkfs(). The disk can be told to
+   fail the next few sector reads, which is how the sdStreamRead() retry is tested.
+
+   Checks block offsets and lengths against the file, short reads at the end of the file (and a
+   file that ends exactly on a block), streams and reads that start off a 4KB boundary, handing
+   out every block before any is released, and recovering from read errors with slowDown().
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "ff.h"
+#include "diskio.h"
+#include "sd_stream.h"
+
+#if !FF_USE_MKFS || FF_FS_READONLY
+#error "The RAM disk is formatted and written with FatFs, so ffconf.h needs FF_USE_MKFS 1 and FF_FS_READONLY 0"
+#endif
+
+#define SECTOR_SIZE 512
+#define DISK_SECTORS 4096 // 2MB
+
+static int failures = 0;
+
+#define CHECK(condition, ...)                                 \
+  do {                                                        \
+    if (!(condition)) {                                       \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__);             \
+      printf(__VA_ARGS__);                                    \
+      printf("\n");                                           \
+      failures += 1;                                          \
+    }                                                         \
+  } while (0)
+
+/* The RAM disk, drive 0: */
+static uint8_t disk[DISK_SECTORS][SECTOR_SIZE];
+static uint32_t failingReads = 0; // disk_read() fails this many more times
+
+DSTATUS disk_status(BYTE pdrv) {
+  return pdrv == 0 ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_initialize(BYTE pdrv) {
+  return disk_status(pdrv);
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE* buff, LBA_t sector, UINT count) {
+  if (pdrv != 0 || sector + count > DISK_SECTORS) {
+    return RES_PARERR;
+  }
+  if (failingReads > 0) { // A bad CRC, or the card not answering
+    failingReads--;
+    return RES_ERROR;
+  }
+  memcpy(buff, disk[sector], (size_t)count * SECTOR_SIZE);
+  return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE* buff, LBA_t sector, UINT count) {
+  if (pdrv != 0 || sector + count > DISK_SECTORS) {
+    return RES_PARERR;
+  }
+  memcpy(disk[sector], buff, (size_t)count * SECTOR_SIZE);
+  return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void* buff) {
+  if (pdrv != 0) {
+    return RES_PARERR;
+  }
+  switch (cmd) {
+  case CTRL_SYNC:
+    return RES_OK;
+  case GET_SECTOR_COUNT:
+    *(LBA_t*)buff = DISK_SECTORS;
+    return RES_OK;
+  case GET_SECTOR_SIZE:
+    *(WORD*)buff = SECTOR_SIZE;
+    return RES_OK;
+  case GET_BLOCK_SIZE:
+    *(DWORD*)buff = 1;
+    return RES_OK;
+  default:
+    return RES_PARERR;
+  }
+}
+
+DWORD get_fattime(void) {
+  return ((DWORD)(2024 - 1980) << 25) | (1u << 21) | (1u << 16);
+}
+
+/* Test helpers: */
+static uint64_t fakeUs = 0;
+static uint64_t fakeClockUs(void) {
+  return fakeUs += 10;
+}
+
+static uint32_t slowDownCalls = 0;
+static uint32_t slowDownSteps = 0; // How many more times slowDown() can lower the clock
+static bool fakeSlowDown(void) {
+  slowDownCalls++;
+  if (slowDownSteps == 0) {
+    return false;
+  }
+  slowDownSteps--;
+  return true;
+}
+
+/// @brief patternByte() is the content of the test files at offset.
+static uint8_t patternByte(uint32_t offset) {
+  return (uint8_t)(offset * 31u + offset / 4096u);
+}
+
+static bool matchesPattern(const uint8_t* data, uint32_t offset, uint32_t length) {
+  for (uint32_t i = 0; i < length; i++) {
+    if (data[i] != patternByte(offset + i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void writeFile(const char* name, uint32_t size) {
+  static uint8_t buffer[1000]; // Not a multiple of anything, so writes straddle sectors
+  FIL fil;
+  UINT written = 0;
+  CHECK(f_open(&fil, name, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK, "f_open %s for writing", name);
+  for (uint32_t offset = 0; offset < size; offset += written) {
+    uint32_t length = size - offset < sizeof(buffer) ? size - offset : sizeof(buffer);
+    for (uint32_t i = 0; i < length; i++) {
+      buffer[i] = patternByte(offset + i);
+    }
+    if (f_write(&fil, buffer, length, &written) != FR_OK || written != length) {
+      CHECK(false, "f_write %s at %u", name, offset);
+      break;
+    }
+  }
+  f_close(&fil);
+}
+
+/// @brief streamFile() streams name from start, releasing each block as soon as it is checked,
+///        and checks every block against the pattern and the file size.
+static void streamFile(const char* name, uint32_t size, uint32_t start) {
+  FIL fil;
+  SDStream stream;
+  CHECK(f_open(&fil, name, FA_READ) == FR_OK, "f_open %s", name);
+  CHECK(f_lseek(&fil, start) == FR_OK, "f_lseek %s to %u", name, start);
+  CHECK(sdStreamOpen(&stream, &fil, fakeClockUs, NULL), "sdStreamOpen %s", name);
+
+  uint32_t offset = start;
+  uint32_t blocks = 0;
+  for (SDStreamBlock* block = sdStreamNext(&stream); block != NULL; block = sdStreamNext(&stream)) {
+    uint32_t expected = size - offset < SD_STREAM_BLOCK_SIZE ? size - offset : SD_STREAM_BLOCK_SIZE;
+    CHECK(block->offset == offset, "%s: block at %u, expected %u", name, block->offset, offset);
+    CHECK(block->length == expected, "%s at %u: %u bytes, expected %u", name, offset, block->length, expected);
+    CHECK(matchesPattern(block->data, block->offset, block->length), "%s at %u: wrong data", name, offset);
+    offset += block->length;
+    blocks++;
+    sdStreamPrefetch(&stream); // Read ahead while "the bus" has the block, then give it back
+    sdStreamRelease(&stream);
+  }
+  CHECK(offset == size, "%s from %u: streamed to %u of %u", name, start, offset, size);
+  CHECK(blocks == (size - start + SD_STREAM_BLOCK_SIZE - 1) / SD_STREAM_BLOCK_SIZE, "%s: %u blocks", name, blocks);
+  CHECK(stream.endOfFile && stream.error == FR_OK, "%s: end %d, error %d", name, stream.endOfFile, stream.error);
+  CHECK(stream.stats.bytes == size - start, "%s: stats count %u bytes", name, (uint32_t)stream.stats.bytes);
+  sdStreamClose(&stream);
+  CHECK(blockPoolAvailable() == BLOCK_POOL_COUNT, "%s: pool has %u free blocks after close", name,
+        blockPoolAvailable());
+  f_close(&fil);
+}
+
+/// @brief holdEveryBlock() takes every block the stream has without releasing any: it must run out
+///        after SD_STREAM_BLOCK_COUNT, then carry on once they come back.
+static void holdEveryBlock(const char* name) {
+  FIL fil;
+  SDStream stream;
+  f_open(&fil, name, FA_READ);
+  sdStreamOpen(&stream, &fil, fakeClockUs, NULL);
+  while (sdStreamPrefetch(&stream)) {}
+  CHECK(stream.readyCount == SD_STREAM_BLOCK_COUNT, "%u blocks prefetched", stream.readyCount);
+
+  SDStreamBlock* held[SD_STREAM_BLOCK_COUNT];
+  for (uint32_t i = 0; i < SD_STREAM_BLOCK_COUNT; i++) {
+    held[i] = sdStreamNext(&stream);
+    CHECK(held[i] != NULL && held[i]->offset == i * SD_STREAM_BLOCK_SIZE, "held block %u", i);
+  }
+  CHECK(sdStreamNext(&stream) == NULL && !stream.endOfFile, "another block with every one handed out");
+  for (uint32_t i = 0; i < SD_STREAM_BLOCK_COUNT; i++) {
+    sdStreamRelease(&stream);
+  }
+  SDStreamBlock* next = sdStreamNext(&stream);
+  CHECK(next != NULL && next->offset == SD_STREAM_BLOCK_COUNT * SD_STREAM_BLOCK_SIZE &&
+        matchesPattern(next->data, next->offset, next->length), "block after the held ones");
+  sdStreamRelease(&stream);
+  sdStreamClose(&stream);
+  f_close(&fil);
+}
+
+/// @brief checkRetries() fails reads underneath sdStreamRead() and the stream.
+static void checkRetries(const char* name, uint32_t size) {
+  static uint8_t buffer[5000];
+  FIL fil;
+  UINT bytesRead = 0;
+  f_open(&fil, name, FA_READ);
+
+  // Across a 4KB boundary, failing twice, with the clock able to come down three steps:
+  f_lseek(&fil, 3000);
+  failingReads = 2;
+  slowDownCalls = 0;
+  slowDownSteps = 3;
+  FRESULT result = sdStreamRead(&fil, buffer, sizeof(buffer), &bytesRead, fakeSlowDown);
+  CHECK(result == FR_OK && bytesRead == sizeof(buffer), "retried read: %d, %u bytes", result, bytesRead);
+  CHECK(matchesPattern(buffer, 3000, bytesRead), "retried read: wrong data");
+  CHECK(slowDownCalls == 2 && f_tell(&fil) == 3000 + sizeof(buffer), "retried read: %u slow downs, at %u",
+        slowDownCalls, (uint32_t)f_tell(&fil));
+
+  // Already at the slowest clock: the error comes back after one try.
+  f_lseek(&fil, 0);
+  failingReads = 1;
+  slowDownCalls = 0;
+  slowDownSteps = 0;
+  result = sdStreamRead(&fil, buffer, 100, &bytesRead, fakeSlowDown);
+  CHECK(result == FR_DISK_ERR && slowDownCalls == 1, "no slower clock: %d, %u slow downs", result, slowDownCalls);
+  f_close(&fil);
+
+  // In the middle of a stream, which carries on as if nothing happened:
+  SDStream stream;
+  f_open(&fil, name, FA_READ);
+  sdStreamOpen(&stream, &fil, fakeClockUs, fakeSlowDown);
+  slowDownSteps = 1;
+  uint32_t offset = 0;
+  for (SDStreamBlock* block = sdStreamNext(&stream); block != NULL; block = sdStreamNext(&stream)) {
+    CHECK(block->offset == offset && matchesPattern(block->data, block->offset, block->length),
+          "stream with a failed read: block at %u", block->offset);
+    offset += block->length;
+    if (offset == SD_STREAM_BLOCK_SIZE) {
+      failingReads = 1;
+    }
+    sdStreamRelease(&stream);
+  }
+  CHECK(offset == size && stream.error == FR_OK, "stream with a failed read: to %u, error %d", offset, stream.error);
+  sdStreamClose(&stream);
+  f_close(&fil);
+
+  // Without slowDown the stream stops on the error, and says so.
+  f_open(&fil, name, FA_READ);
+  sdStreamOpen(&stream, &fil, fakeClockUs, NULL);
+  failingReads = 1;
+  CHECK(sdStreamNext(&stream) == NULL && stream.error == FR_DISK_ERR, "stream error: %d", stream.error);
+  failingReads = 0;
+  sdStreamClose(&stream);
+  f_close(&fil);
+}
+
+int main(void) {
+  static FATFS fs;
+  static uint8_t work[FF_MAX_SS * 4];
+  const MKFS_PARM format = { FM_ANY | FM_SFD, 0, 0, 0, 0 };
+  if (f_mkfs("0:", &format, work, sizeof(work)) != FR_OK || f_mount(&fs, "0:", 1) != FR_OK) {
+    printf("FAIL: could not format and mount the RAM disk\n");
+    return 1;
+  }
+
+  const uint32_t shortSize = 3 * SD_STREAM_BLOCK_SIZE + 1000; // Ends with a short block
+  const uint32_t exactSize = 8 * SD_STREAM_BLOCK_SIZE;        // Ends on a block boundary
+  writeFile("short.bin", shortSize);
+  writeFile("exact.bin", exactSize);
+  writeFile("tiny.bin", 100);
+
+  streamFile("short.bin", shortSize, 0);
+  streamFile("exact.bin", exactSize, 0);
+  streamFile("tiny.bin", 100, 0);
+  streamFile("exact.bin", exactSize, 1000); // Every block straddles a 4KB boundary of the file
+  streamFile("short.bin", shortSize, 3 * SD_STREAM_BLOCK_SIZE + 999);
+  holdEveryBlock("exact.bin");
+  checkRetries("exact.bin", exactSize);
+
+  f_unmount("0:");
+  if (failures > 0) {
+    printf("%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("sd_stream.c: all checks passed\n");
+  return 0;
+}
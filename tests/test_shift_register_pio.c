@@ -0,0 +1,406 @@
+/* test_shift_register_pio.c
+   Runs shift_register.pio on a cycle-level model of a PIO state machine and checks what it does
+   to the DATA (SER), LATCH (RCLK) and CLOCK (SRCLK) pins.
+
+   The program is read from the .pio file and assembled here, so the test follows the file as it
+   changes. Only the instructions shift_register.pio uses are understood (pull, out, jmp, set and
+   nop); anything else fails the test rather than being guessed at. The state machine is set up
+   the way shift_register_program_init() does it: OUT drives DATA, side-set bit 0 is LATCH and
+   bit 1 is CLOCK, the OSR shifts right and there is no autopull.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_INSTRUCTIONS 32
+#define MAX_LABELS 16
+#define MAX_FIFO 8
+#define MAX_TRACE 4096
+
+// The word layout and flags, as SHIFT_WORD() in shift_register.pio's c-sdk block:
+#define SHIFT_FLAG_LATCH 0x1
+#define SHIFT_FLAG_SHIFT 0x2
+#define SHIFT_WORD(address, flags) ((((uint32_t)(address)) << 2) | (flags))
+#define ADDRESS_BITS 24
+
+static int failures = 0;
+
+#define CHECK(condition, ...)                                 \
+  do {                                                        \
+    if (!(condition)) {                                       \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__);             \
+      printf(__VA_ARGS__);                                    \
+      printf("\n");                                           \
+      failures += 1;                                          \
+    }                                                         \
+  } while (0)
+
+typedef enum { OP_PULL, OP_OUT, OP_JMP, OP_SET, OP_NOP } Op;
+typedef enum { COND_ALWAYS, COND_NOT_X, COND_X_DEC, COND_NOT_Y, COND_Y_DEC } JmpCondition;
+typedef enum { DEST_PINS, DEST_X, DEST_Y, DEST_NULL } Destination;
+
+typedef struct {
+  Op op;
+  Destination dest;
+  JmpCondition condition;
+  char target[32];  // jmp label, resolved into address after parsing
+  uint32_t address;
+  uint32_t value;   // out bit count, or set value
+  bool block;       // pull block
+  uint32_t side;
+  uint32_t delay;
+} Instruction;
+
+typedef struct {
+  Instruction code[MAX_INSTRUCTIONS];
+  uint32_t length;
+  uint32_t sideSetBits;
+  uint32_t wrapTarget;
+  uint32_t wrap;
+  uint32_t cyclesPerBit; // SHIFT_REGISTER_CYCLES_PER_BIT from the c-sdk block
+} Program;
+
+/// @brief The pins, one entry per state machine cycle.
+typedef struct {
+  uint8_t data[MAX_TRACE];
+  uint8_t latch[MAX_TRACE];
+  uint8_t clock[MAX_TRACE];
+  uint32_t length;
+} Trace;
+
+/// @brief parseNumber() reads a decimal, 0x or 0b number.
+static bool parseNumber(const char* text, uint32_t* value) {
+  char* end = NULL;
+  if (strncmp(text, "0b", 2) == 0) {
+    *value = (uint32_t)strtoul(text + 2, &end, 2);
+  } else {
+    *value = (uint32_t)strtoul(text, &end, 0);
+  }
+  return end != text && (*end == '\0' || *end == ',');
+}
+
+static bool parseDestination(const char* text, Destination* dest) {
+  if (strcmp(text, "pins,") == 0) { *dest = DEST_PINS; return true; }
+  if (strcmp(text, "x,") == 0) { *dest = DEST_X; return true; }
+  if (strcmp(text, "y,") == 0) { *dest = DEST_Y; return true; }
+  if (strcmp(text, "null,") == 0) { *dest = DEST_NULL; return true; }
+  return false;
+}
+
+/// @brief parseInstruction() assembles one line of the program, already split into words.
+static bool parseInstruction(char** words, int count, Instruction* inst) {
+  memset(inst, 0, sizeof(*inst));
+  int operands = count;
+  for (int i = 0; i < count; i++) { // "side n" and "[n]" come after the operands
+    if (strcmp(words[i], "side") == 0 && i + 1 < count) {
+      if (!parseNumber(words[i + 1], &inst->side)) { return false; }
+      operands = operands < i ? operands : i;
+      i++;
+    } else if (words[i][0] == '[') {
+      inst->delay = (uint32_t)strtoul(words[i] + 1, NULL, 0);
+      operands = operands < i ? operands : i;
+    }
+  }
+
+  const char* name = words[0];
+  if (strcmp(name, "pull") == 0) {
+    inst->op = OP_PULL;
+    inst->block = operands < 2 || strcmp(words[1], "noblock") != 0;
+    return true;
+  }
+  if (strcmp(name, "nop") == 0 && operands == 1) {
+    inst->op = OP_NOP;
+    return true;
+  }
+  if ((strcmp(name, "out") == 0 || strcmp(name, "set") == 0) && operands == 3) {
+    inst->op = name[0] == 'o' ? OP_OUT : OP_SET;
+    return parseDestination(words[1], &inst->dest) && parseNumber(words[2], &inst->value);
+  }
+  if (strcmp(name, "jmp") == 0 && (operands == 2 || operands == 3)) {
+    inst->op = OP_JMP;
+    inst->condition = COND_ALWAYS;
+    if (operands == 3) {
+      const char* condition = words[1];
+      if (strcmp(condition, "!x") == 0) { inst->condition = COND_NOT_X; }
+      else if (strcmp(condition, "x--") == 0) { inst->condition = COND_X_DEC; }
+      else if (strcmp(condition, "!y") == 0) { inst->condition = COND_NOT_Y; }
+      else if (strcmp(condition, "y--") == 0) { inst->condition = COND_Y_DEC; }
+      else { return false; }
+    }
+    snprintf(inst->target, sizeof(inst->target), "%s", words[operands - 1]);
+    return true;
+  }
+  return false;
+}
+
+/// @brief loadProgram() assembles the first program in a .pio file.
+static bool loadProgram(const char* path, Program* program) {
+  FILE* file = fopen(path, "r");
+  if (file == NULL) {
+    printf("Could not open %s\n", path);
+    return false;
+  }
+
+  char labels[MAX_LABELS][32];
+  uint32_t labelAddresses[MAX_LABELS];
+  uint32_t labelCount = 0;
+  bool inProgram = false;
+  bool inSdk = false;
+  bool ok = true;
+  char line[256];
+  memset(program, 0, sizeof(*program));
+  program->wrap = UINT32_MAX;
+
+  while (ok && fgets(line, sizeof(line), file) != NULL) {
+    if (strncmp(line, "% c-sdk", 7) == 0) { inSdk = true; }
+    if (inSdk) {
+      sscanf(line, "#define SHIFT_REGISTER_CYCLES_PER_BIT %u", &program->cyclesPerBit);
+      continue;
+    }
+
+    char* comment = strchr(line, ';');
+    if (comment != NULL) { *comment = '\0'; }
+    char* words[16];
+    int count = 0;
+    for (char* word = strtok(line, " \t\r\n"); word != NULL && count < 16; word = strtok(NULL, " \t\r\n")) {
+      words[count++] = word;
+    }
+    if (count == 0) { continue; }
+
+    if (strcmp(words[0], ".program") == 0) {
+      ok = !inProgram; // Only the first program in the file
+      inProgram = true;
+    } else if (strcmp(words[0], ".side_set") == 0 && count >= 2) {
+      ok = count == 2 && parseNumber(words[1], &program->sideSetBits); // No opt / pindirs
+    } else if (strcmp(words[0], ".wrap_target") == 0) {
+      program->wrapTarget = program->length;
+    } else if (strcmp(words[0], ".wrap") == 0) {
+      program->wrap = program->length - 1;
+    } else if (words[0][strlen(words[0]) - 1] == ':' && labelCount < MAX_LABELS) {
+      words[0][strlen(words[0]) - 1] = '\0';
+      snprintf(labels[labelCount], sizeof(labels[0]), "%s", words[0]);
+      labelAddresses[labelCount++] = program->length;
+    } else if (program->length < MAX_INSTRUCTIONS) {
+      ok = parseInstruction(words, count, &program->code[program->length]);
+      if (!ok) { printf("Can't assemble instruction %u (%s ...)\n", program->length, words[0]); }
+      program->length++;
+    } else {
+      ok = false;
+    }
+  }
+  fclose(file);
+
+  if (program->wrap == UINT32_MAX) { program->wrap = program->length - 1; }
+  for (uint32_t i = 0; ok && i < program->length; i++) {
+    Instruction* inst = &program->code[i];
+    if (inst->op != OP_JMP) { continue; }
+    ok = false;
+    for (uint32_t j = 0; j < labelCount; j++) {
+      if (strcmp(labels[j], inst->target) == 0) {
+        inst->address = labelAddresses[j];
+        ok = true;
+      }
+    }
+    if (!ok) { printf("Unknown label %s\n", inst->target); }
+  }
+  return ok && program->length > 0;
+}
+
+/// @brief The state machine, as far as shift_register.pio can see it.
+typedef struct {
+  uint32_t pc;
+  uint32_t x;
+  uint32_t y;
+  uint32_t osr;
+  uint32_t delay;      // Delay cycles left of the current instruction
+  uint32_t fifo[MAX_FIFO];
+  uint32_t fifoCount;
+  uint8_t data;        // OUT pin
+  uint32_t side;       // Side-set pins
+  bool stalled;        // On a pull block with an empty FIFO
+} StateMachine;
+
+/// @brief step() runs one state machine cycle and records the pins for it.
+static void step(const Program* program, StateMachine* sm, Trace* trace) {
+  if (sm->delay > 0) {
+    sm->delay--;
+  } else {
+    const Instruction* inst = &program->code[sm->pc];
+    sm->side = inst->side; // Side-set takes effect even if the instruction stalls
+    uint32_t next = sm->pc == program->wrap ? program->wrapTarget : sm->pc + 1;
+    sm->stalled = false;
+
+    switch (inst->op) {
+    case OP_PULL:
+      if (sm->fifoCount == 0) {
+        sm->stalled = inst->block;
+        next = inst->block ? sm->pc : next; // pull noblock copies X, not used here
+      } else {
+        sm->osr = sm->fifo[0];
+        memmove(sm->fifo, sm->fifo + 1, --sm->fifoCount * sizeof(sm->fifo[0]));
+      }
+      break;
+    case OP_OUT: {
+      uint32_t value = inst->value == 32 ? sm->osr : sm->osr & ((1u << inst->value) - 1);
+      sm->osr = inst->value == 32 ? 0 : sm->osr >> inst->value; // Shift right
+      if (inst->dest == DEST_PINS) { sm->data = value & 1; }
+      if (inst->dest == DEST_X) { sm->x = value; }
+      if (inst->dest == DEST_Y) { sm->y = value; }
+      break;
+    }
+    case OP_SET:
+      if (inst->dest == DEST_X) { sm->x = inst->value; }
+      if (inst->dest == DEST_Y) { sm->y = inst->value; }
+      break;
+    case OP_JMP: {
+      bool taken = true;
+      if (inst->condition == COND_NOT_X) { taken = sm->x == 0; }
+      if (inst->condition == COND_NOT_Y) { taken = sm->y == 0; }
+      if (inst->condition == COND_X_DEC) { taken = sm->x-- != 0; }
+      if (inst->condition == COND_Y_DEC) { taken = sm->y-- != 0; }
+      next = taken ? inst->address : next;
+      break;
+    }
+    case OP_NOP:
+      break;
+    }
+
+    if (!sm->stalled) {
+      sm->pc = next;
+      sm->delay = inst->delay;
+    }
+  }
+
+  if (trace->length < MAX_TRACE) {
+    trace->data[trace->length] = sm->data;
+    trace->latch[trace->length] = sm->side & 1;
+    trace->clock[trace->length] = (sm->side >> 1) & 1;
+    trace->length++;
+  }
+}
+
+/// @brief run() pushes words and runs until the program is back waiting on an empty FIFO.
+static void run(const Program* program, StateMachine* sm, const uint32_t* words, uint32_t count,
+                Trace* trace) {
+  memset(trace, 0, sizeof(*trace));
+  for (uint32_t i = 0; i < count && sm->fifoCount < MAX_FIFO; i++) {
+    sm->fifo[sm->fifoCount++] = words[i];
+  }
+  do {
+    step(program, sm, trace);
+  } while (!(sm->stalled && sm->fifoCount == 0) && trace->length < MAX_TRACE);
+}
+
+/// @brief What the pins did over a run.
+typedef struct {
+  uint32_t clockPulses;
+  uint32_t latchPulses;
+  uint32_t bits;          // SER sampled on each rising SRCLK edge, first bit in bit 0
+  bool dataStable;        // SER held for a cycle either side of every rising SRCLK edge
+  bool evenClock;         // Every rising SRCLK edge cyclesPerBit after the one before
+  int lastClockFall;      // Cycle SRCLK last went low, -1 if it never pulsed
+  int firstLatchRise;     // Cycle RCLK first went high, -1 if it never pulsed
+  bool clockLowAtLatch;   // SRCLK low while RCLK is high
+} PinActivity;
+
+static PinActivity analyze(const Trace* trace, uint32_t cyclesPerBit) {
+  PinActivity activity = { 0, 0, 0, true, true, -1, -1, true };
+  int lastRise = -1;
+  for (uint32_t t = 1; t < trace->length; t++) {
+    if (trace->clock[t] && !trace->clock[t - 1]) {
+      bool held = trace->data[t] == trace->data[t - 1] && (t + 1 >= trace->length || trace->data[t + 1] == trace->data[t]);
+      activity.dataStable = activity.dataStable && held;
+      if (lastRise >= 0 && (uint32_t)(t - lastRise) != cyclesPerBit) {
+        activity.evenClock = false;
+      }
+      lastRise = (int)t;
+      if (activity.clockPulses < 32) {
+        activity.bits |= (uint32_t)trace->data[t] << activity.clockPulses;
+      }
+      activity.clockPulses++;
+    }
+    if (!trace->clock[t] && trace->clock[t - 1]) {
+      activity.lastClockFall = (int)t;
+    }
+    if (trace->latch[t] && !trace->latch[t - 1]) {
+      activity.latchPulses++;
+      activity.firstLatchRise = activity.firstLatchRise < 0 ? (int)t : activity.firstLatchRise;
+    }
+    if (trace->latch[t] && trace->clock[t]) {
+      activity.clockLowAtLatch = false;
+    }
+  }
+  return activity;
+}
+
+/// @brief checkWord() runs one word and checks the shift and latch against its flags.
+static void checkWord(const Program* program, StateMachine* sm, uint32_t address, uint32_t flags) {
+  static Trace trace;
+  uint32_t word = SHIFT_WORD(address, flags);
+  run(program, sm, &word, 1, &trace);
+  PinActivity activity = analyze(&trace, program->cyclesPerBit);
+  bool shift = (flags & SHIFT_FLAG_SHIFT) != 0;
+  bool latch = (flags & SHIFT_FLAG_LATCH) != 0;
+
+  CHECK(trace.length < MAX_TRACE, "0x%06X flags %u: never went back to waiting for a word", address, flags);
+  CHECK(activity.clockPulses == (shift ? ADDRESS_BITS : 0u), "0x%06X flags %u: %u SRCLK pulses",
+        address, flags, activity.clockPulses);
+  if (shift) {
+    // Address bit 0 goes out first, the order the bit-banged shiftAddress() uses and the board's
+    // 74HC595 chain is wired for. After the 24th clock the most significant address bit is the
+    // one nearest SER, in the first register of the chain.
+    uint32_t expected = address & ((1u << ADDRESS_BITS) - 1);
+    CHECK(activity.bits == expected, "0x%06X: SER carried 0x%06X", address, activity.bits);
+    CHECK(activity.dataStable, "0x%06X: SER changed next to a rising SRCLK edge", address);
+    CHECK(activity.evenClock, "0x%06X: bits not %u cycles apart", address, program->cyclesPerBit);
+  }
+  CHECK(activity.latchPulses == (latch ? 1u : 0u), "0x%06X flags %u: %u RCLK pulses", address, flags,
+        activity.latchPulses);
+  if (shift && latch) {
+    CHECK(activity.firstLatchRise > activity.lastClockFall, "0x%06X: RCLK rose before the last bit was in",
+          address);
+  }
+  CHECK(activity.clockLowAtLatch, "0x%06X flags %u: SRCLK high with RCLK", address, flags);
+  CHECK(trace.latch[trace.length - 1] == 0 && trace.clock[trace.length - 1] == 0,
+        "0x%06X flags %u: pins not left low", address, flags);
+}
+
+int main(void) {
+  static Program program;
+  if (!loadProgram(SHIFT_REGISTER_PIO, &program)) {
+    printf("FAIL: could not assemble %s\n", SHIFT_REGISTER_PIO);
+    return 1;
+  }
+  CHECK(program.sideSetBits == 2, ".side_set %u, expected LATCH and CLOCK", program.sideSetBits);
+  CHECK(program.cyclesPerBit > 0, "SHIFT_REGISTER_CYCLES_PER_BIT not found");
+
+  StateMachine sm;
+  memset(&sm, 0, sizeof(sm));
+  const uint32_t addresses[] = { 0x000000, 0xFFFFFF, 0x000001, 0x800000, 0xA5A5A5, 0x5A5A5A, 0x123456, 0x07FFFF };
+  const uint32_t flags[] = { SHIFT_FLAG_SHIFT | SHIFT_FLAG_LATCH, SHIFT_FLAG_SHIFT, SHIFT_FLAG_LATCH };
+  for (size_t i = 0; i < sizeof(addresses) / sizeof(addresses[0]); i++) {
+    for (size_t j = 0; j < sizeof(flags) / sizeof(flags[0]); j++) {
+      checkWord(&program, &sm, addresses[i], flags[j]);
+    }
+  }
+
+  // The pipelined bus: shift the next address in ahead of time, then latch it on its own.
+  static Trace trace;
+  uint32_t words[] = { SHIFT_WORD(0x3C3C3C, SHIFT_FLAG_SHIFT), SHIFT_WORD(0, SHIFT_FLAG_LATCH) };
+  run(&program, &sm, words, 2, &trace);
+  PinActivity activity = analyze(&trace, program.cyclesPerBit);
+  CHECK(activity.clockPulses == ADDRESS_BITS && activity.bits == 0x3C3C3C, "preload: %u pulses, SER 0x%06X",
+        activity.clockPulses, activity.bits);
+  CHECK(activity.latchPulses == 1 && activity.firstLatchRise > activity.lastClockFall,
+        "preload: %u RCLK pulses", activity.latchPulses);
+
+  if (failures > 0) {
+    printf("%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("shift_register.pio: all checks passed\n");
+  return 0;
+}